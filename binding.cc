@@ -3,6 +3,27 @@
 
 #include <v8.h>
 #include <node.h>
+#include <node_buffer.h>
+
+#include <errno.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 extern "C" {
 #include <yaml.h>
@@ -64,6 +85,35 @@ static Persistent<String> context_symbol;
 static Persistent<String> problem_symbol;
 static Persistent<String> description_symbol;
 
+// Handler methods, indexed by event type.
+static Persistent<String> handler_method_symbols[YAML_MAPPING_END_EVENT + 1];
+
+// Parser options.
+static Persistent<String> marks_symbol;
+static Persistent<String> fields_symbol;
+static Persistent<String> flyweight_symbol;
+
+// Builder options.
+static Persistent<String> tag_handlers_symbol;
+static Persistent<String> typed_arrays_symbol;
+static Persistent<String> columnar_symbol;
+static Persistent<String> maps_symbol;
+static Persistent<String> unique_keys_symbol;
+static Persistent<String> dedupe_symbol;
+static Persistent<String> buffer_symbol;
+static Persistent<String> int32_array_symbol;
+static Persistent<String> float64_array_symbol;
+static Persistent<String> map_symbol;
+static Persistent<String> prototype_symbol;
+static Persistent<String> set_symbol;
+static Persistent<String> object_symbol;
+static Persistent<String> freeze_symbol;
+static Persistent<String> length_symbol;
+static Persistent<String> slice_symbol;
+static Persistent<String> abort_flag_symbol;
+static Persistent<String> timeout_symbol;
+static Persistent<String> code_symbol;
+
 
 // Convert from LibYAML's booleans.
 static inline Handle<Boolean>
@@ -98,107 +148,461 @@ MarkToJs(yaml_mark_t &mark)
   return obj;
 }
 
+// Same as above, but only exposes the index. Line and column can be recovered from the input
+// afterwards, see `YAML.stream.createLocator`.
+static inline Local<Value>
+MarkIndexToJs(yaml_mark_t &mark)
+{
+  return Integer::NewFromUnsigned(mark.index);
+}
+
+
+// Event fields, as selected with the `fields` option of `parse`.
+enum {
+  FIELD_TYPE            = 1 << 0,
+  FIELD_START           = 1 << 1,
+  FIELD_END             = 1 << 2,
+  FIELD_VERSION         = 1 << 3,
+  FIELD_IMPLICIT        = 1 << 4,
+  FIELD_ANCHOR          = 1 << 5,
+  FIELD_TAG             = 1 << 6,
+  FIELD_VALUE           = 1 << 7,
+  FIELD_PLAIN_IMPLICIT  = 1 << 8,
+  FIELD_QUOTED_IMPLICIT = 1 << 9,
+  FIELD_STYLE           = 1 << 10,
+  FIELD_ALL             = (1 << 11) - 1,
+
+  // Not fields, but select `MarkIndexToJs` for `start` and `end`, and flyweight mode.
+  INDEX_MARKS           = 1 << 11,
+  FLYWEIGHT             = 1 << 12
+};
+
+// Convert an event's scalar, sequence or mapping style.
+static inline Handle<Value>
+ScalarStyleToJs(yaml_scalar_style_t style)
+{
+  switch (style) {
+    case YAML_PLAIN_SCALAR_STYLE:         return plain_symbol;
+    case YAML_SINGLE_QUOTED_SCALAR_STYLE: return single_quoted_symbol;
+    case YAML_DOUBLE_QUOTED_SCALAR_STYLE: return double_quoted_symbol;
+    case YAML_LITERAL_SCALAR_STYLE:       return literal_symbol;
+    case YAML_FOLDED_SCALAR_STYLE:        return folded_symbol;
+    default:                              return Handle<Value>();
+  }
+}
+
+static inline Handle<Value>
+SequenceStyleToJs(yaml_sequence_style_t style)
+{
+  switch (style) {
+    case YAML_BLOCK_SEQUENCE_STYLE: return block_symbol;
+    case YAML_FLOW_SEQUENCE_STYLE:  return flow_symbol;
+    default:                        return Handle<Value>();
+  }
+}
+
+static inline Handle<Value>
+MappingStyleToJs(yaml_mapping_style_t style)
+{
+  switch (style) {
+    case YAML_BLOCK_MAPPING_STYLE: return block_symbol;
+    case YAML_FLOW_MAPPING_STYLE:  return flow_symbol;
+    default:                       return Handle<Value>();
+  }
+}
 
-// Create an object from a LibYAML event.
+
+// Objects that are reused for every event in flyweight mode.
+struct Flyweight {
+  Local<Object> event;
+  Local<Object> start;
+  Local<Object> end;
+};
+
+// Overwrite the properties of a reused mark object.
 static inline Local<Object>
-EventToJs(yaml_event_t &event)
+FillMark(Local<Object> obj, yaml_mark_t &mark)
+{
+  obj->Set(index_symbol,  Integer::NewFromUnsigned(mark.index));
+  obj->Set(line_symbol,   Integer::NewFromUnsigned(mark.line));
+  obj->Set(column_symbol, Integer::NewFromUnsigned(mark.column));
+  return obj;
+}
+
+// Set an event property. Properties that don't apply to the event type are skipped, except in
+// flyweight mode, where they are reset so no stale values remain from earlier events.
+static inline void
+SetEventField(Local<Object> obj, Handle<String> key, Handle<Value> value, bool flyweight)
 {
-  Local<Object> obj, tmp;
+  if (!value.IsEmpty())
+    obj->Set(key, value);
+  else if (flyweight)
+    obj->Set(key, Null());
+}
+
 
-  // Create the event object.
-  obj = Object::New();
-  obj->Set(start_symbol, MarkToJs(event.start_mark));
-  obj->Set(end_symbol,   MarkToJs(event.end_mark));
+// Create an object from a LibYAML event, with only the fields selected in `flags`. In flyweight
+// mode, the objects in `fly` are updated and returned instead.
+//
+// When `Fixed` is non-zero, it is used in place of `flags`. Because it is then a constant, the
+// compiler can drop all the tests for fields that are never set. See `SelectEventToJs`.
+template <int Fixed>
+static Local<Object>
+EventToJs(yaml_event_t &event, int flags, Flyweight *fly)
+{
+  const int f = Fixed ? Fixed : flags;
+  const bool flyweight = (f & FLYWEIGHT) != 0;
+  Local<Object> obj = flyweight ? fly->event : Object::New();
+  Handle<Value> type, version, implicit, anchor, tag, value,
+      plain_implicit, quoted_implicit, style;
+  Local<Object> tmp;
 
   switch (event.type) {
     case YAML_STREAM_START_EVENT:
-      obj->Set(type_symbol, stream_start_symbol);
+      type = stream_start_symbol;
       break;
 
     case YAML_STREAM_END_EVENT:
-      obj->Set(type_symbol, stream_end_symbol);
+      type = stream_end_symbol;
       break;
 
     case YAML_DOCUMENT_START_EVENT:
-      obj->Set(type_symbol, document_start_symbol);
-      if (event.data.document_start.version_directive) {
-        tmp = Object::New();
-        tmp->Set(major_symbol, Integer::New(event.data.document_start.version_directive->major));
-        tmp->Set(minor_symbol, Integer::New(event.data.document_start.version_directive->minor));
-        obj->Set(version_symbol, tmp);
+      type = document_start_symbol;
+      if (f & FIELD_VERSION) {
+        if (event.data.document_start.version_directive) {
+          tmp = Object::New();
+          tmp->Set(major_symbol, Integer::New(event.data.document_start.version_directive->major));
+          tmp->Set(minor_symbol, Integer::New(event.data.document_start.version_directive->minor));
+          version = tmp;
+        }
+        else
+          version = Null();
       }
-      else
-        obj->Set(version_symbol, Null());
-      obj->Set(implicit_symbol, BoolToJs(event.data.document_start.implicit));
+      if (f & FIELD_IMPLICIT)
+        implicit = BoolToJs(event.data.document_start.implicit);
       break;
 
     case YAML_DOCUMENT_END_EVENT:
-      obj->Set(type_symbol, document_end_symbol);
-      obj->Set(implicit_symbol, BoolToJs(event.data.document_end.implicit));
+      type = document_end_symbol;
+      if (f & FIELD_IMPLICIT)
+        implicit = BoolToJs(event.data.document_end.implicit);
       break;
 
     case YAML_ALIAS_EVENT:
-      obj->Set(type_symbol, alias_symbol);
-      obj->Set(anchor_symbol, StringToJs(event.data.alias.anchor));
+      type = alias_symbol;
+      if (f & FIELD_ANCHOR)
+        anchor = StringToJs(event.data.alias.anchor);
       break;
 
     case YAML_SCALAR_EVENT:
-      obj->Set(type_symbol, scalar_symbol);
-      obj->Set(anchor_symbol, StringToJs(event.data.scalar.anchor));
-      obj->Set(tag_symbol,    StringToJs(event.data.scalar.tag));
-      obj->Set(value_symbol,  StringToJs(event.data.scalar.value, event.data.scalar.length));
-      obj->Set(plain_implicit_symbol,  BoolToJs(event.data.scalar.plain_implicit));
-      obj->Set(quoted_implicit_symbol, BoolToJs(event.data.scalar.quoted_implicit));
-      switch (event.data.scalar.style) {
-        case YAML_PLAIN_SCALAR_STYLE:         obj->Set(style_symbol, plain_symbol);         break;
-        case YAML_SINGLE_QUOTED_SCALAR_STYLE: obj->Set(style_symbol, single_quoted_symbol); break;
-        case YAML_DOUBLE_QUOTED_SCALAR_STYLE: obj->Set(style_symbol, double_quoted_symbol); break;
-        case YAML_LITERAL_SCALAR_STYLE:       obj->Set(style_symbol, literal_symbol);       break;
-        case YAML_FOLDED_SCALAR_STYLE:        obj->Set(style_symbol, folded_symbol);        break;
-        default: break;
-      }
+      type = scalar_symbol;
+      if (f & FIELD_ANCHOR)
+        anchor = StringToJs(event.data.scalar.anchor);
+      if (f & FIELD_TAG)
+        tag    = StringToJs(event.data.scalar.tag);
+      if (f & FIELD_VALUE)
+        value  = StringToJs(event.data.scalar.value, event.data.scalar.length);
+      if (f & FIELD_PLAIN_IMPLICIT)
+        plain_implicit  = BoolToJs(event.data.scalar.plain_implicit);
+      if (f & FIELD_QUOTED_IMPLICIT)
+        quoted_implicit = BoolToJs(event.data.scalar.quoted_implicit);
+      if (f & FIELD_STYLE)
+        style = ScalarStyleToJs(event.data.scalar.style);
       break;
 
     case YAML_SEQUENCE_START_EVENT:
-      obj->Set(type_symbol, sequence_start_symbol);
-      obj->Set(anchor_symbol,    StringToJs(event.data.sequence_start.anchor));
-      obj->Set(tag_symbol,       StringToJs(event.data.sequence_start.tag));
-      obj->Set(implicit_symbol, BoolToJs(event.data.sequence_start.implicit));
-      switch (event.data.sequence_start.style) {
-        case YAML_BLOCK_SEQUENCE_STYLE: obj->Set(style_symbol, block_symbol); break;
-        case YAML_FLOW_SEQUENCE_STYLE:  obj->Set(style_symbol, flow_symbol);  break;
-        default: break;
-      }
+      type = sequence_start_symbol;
+      if (f & FIELD_ANCHOR)
+        anchor   = StringToJs(event.data.sequence_start.anchor);
+      if (f & FIELD_TAG)
+        tag      = StringToJs(event.data.sequence_start.tag);
+      if (f & FIELD_IMPLICIT)
+        implicit = BoolToJs(event.data.sequence_start.implicit);
+      if (f & FIELD_STYLE)
+        style    = SequenceStyleToJs(event.data.sequence_start.style);
       break;
 
     case YAML_SEQUENCE_END_EVENT:
-      obj->Set(type_symbol, sequence_end_symbol);
+      type = sequence_end_symbol;
       break;
 
     case YAML_MAPPING_START_EVENT:
-      obj->Set(type_symbol, mapping_start_symbol);
-      obj->Set(anchor_symbol,    StringToJs(event.data.mapping_start.anchor));
-      obj->Set(tag_symbol,       StringToJs(event.data.mapping_start.tag));
-      obj->Set(implicit_symbol, BoolToJs(event.data.mapping_start.implicit));
-      switch (event.data.mapping_start.style) {
-        case YAML_BLOCK_MAPPING_STYLE: obj->Set(style_symbol, block_symbol); break;
-        case YAML_FLOW_MAPPING_STYLE:  obj->Set(style_symbol, flow_symbol);  break;
-        default: break;
-      }
+      type = mapping_start_symbol;
+      if (f & FIELD_ANCHOR)
+        anchor   = StringToJs(event.data.mapping_start.anchor);
+      if (f & FIELD_TAG)
+        tag      = StringToJs(event.data.mapping_start.tag);
+      if (f & FIELD_IMPLICIT)
+        implicit = BoolToJs(event.data.mapping_start.implicit);
+      if (f & FIELD_STYLE)
+        style    = MappingStyleToJs(event.data.mapping_start.style);
       break;
 
     case YAML_MAPPING_END_EVENT:
-      obj->Set(type_symbol, mapping_end_symbol);
+      type = mapping_end_symbol;
       break;
 
     default:
-      obj->Set(type_symbol, Null());
+      type = Null();
       break;
   }
 
+  if (f & FIELD_START) {
+    if (f & INDEX_MARKS)
+      obj->Set(start_symbol, MarkIndexToJs(event.start_mark));
+    else
+      obj->Set(start_symbol, flyweight
+          ? FillMark(fly->start, event.start_mark) : MarkToJs(event.start_mark));
+  }
+  if (f & FIELD_END) {
+    if (f & INDEX_MARKS)
+      obj->Set(end_symbol, MarkIndexToJs(event.end_mark));
+    else
+      obj->Set(end_symbol, flyweight
+          ? FillMark(fly->end, event.end_mark) : MarkToJs(event.end_mark));
+  }
+  if (f & FIELD_TYPE)
+    obj->Set(type_symbol, type);
+  if (f & FIELD_VERSION)
+    SetEventField(obj, version_symbol, version, flyweight);
+  if (f & FIELD_IMPLICIT)
+    SetEventField(obj, implicit_symbol, implicit, flyweight);
+  if (f & FIELD_ANCHOR)
+    SetEventField(obj, anchor_symbol, anchor, flyweight);
+  if (f & FIELD_TAG)
+    SetEventField(obj, tag_symbol, tag, flyweight);
+  if (f & FIELD_VALUE)
+    SetEventField(obj, value_symbol, value, flyweight);
+  if (f & FIELD_PLAIN_IMPLICIT)
+    SetEventField(obj, plain_implicit_symbol, plain_implicit, flyweight);
+  if (f & FIELD_QUOTED_IMPLICIT)
+    SetEventField(obj, quoted_implicit_symbol, quoted_implicit, flyweight);
+  if (f & FIELD_STYLE)
+    SetEventField(obj, style_symbol, style, flyweight);
+
   return obj;
 }
 
+typedef Local<Object> (*EventToJsFunction)(yaml_event_t &event, int flags, Flyweight *fly);
+
+// Pick a specialized `EventToJs` for common field selections, or fall back to the generic one.
+static EventToJsFunction
+SelectEventToJs(int flags)
+{
+  switch (flags) {
+    case FIELD_ALL:                                     return EventToJs<FIELD_ALL>;
+    case FIELD_ALL | INDEX_MARKS:                       return EventToJs<FIELD_ALL | INDEX_MARKS>;
+    case FIELD_ALL | FLYWEIGHT:                         return EventToJs<FIELD_ALL | FLYWEIGHT>;
+    case FIELD_ALL | INDEX_MARKS | FLYWEIGHT:
+      return EventToJs<FIELD_ALL | INDEX_MARKS | FLYWEIGHT>;
+    case FIELD_TYPE:                                    return EventToJs<FIELD_TYPE>;
+    case FIELD_TYPE | FIELD_VALUE:                      return EventToJs<FIELD_TYPE | FIELD_VALUE>;
+    case FIELD_TYPE | FIELD_VALUE | FLYWEIGHT:          return EventToJs<FIELD_TYPE | FIELD_VALUE | FLYWEIGHT>;
+    case FIELD_TYPE | FIELD_VALUE | FIELD_TAG:          return EventToJs<FIELD_TYPE | FIELD_VALUE | FIELD_TAG>;
+    case FIELD_TYPE | FIELD_VALUE | FIELD_TAG | FIELD_ANCHOR:
+      return EventToJs<FIELD_TYPE | FIELD_VALUE | FIELD_TAG | FIELD_ANCHOR>;
+    default:                                            return EventToJs<0>;
+  }
+}
+
+// Build the single event object used in flyweight mode. Creating it from a template with all
+// selected properties gives it a fixed layout from the start.
+static void
+CreateFlyweight(Flyweight &fly, int flags)
+{
+  Local<ObjectTemplate> event_template = ObjectTemplate::New();
+  static Persistent<String> *const fields[] = {
+    &type_symbol, &start_symbol, &end_symbol, &version_symbol, &implicit_symbol,
+    &anchor_symbol, &tag_symbol, &value_symbol, &plain_implicit_symbol,
+    &quoted_implicit_symbol, &style_symbol
+  };
+  for (int i = 0; i < (int)(sizeof(fields) / sizeof(fields[0])); i++) {
+    if (flags & (1 << i))
+      event_template->Set(*fields[i], Null());
+  }
+  fly.event = event_template->NewInstance();
+
+  if (!(flags & INDEX_MARKS)) {
+    Local<ObjectTemplate> mark_template = ObjectTemplate::New();
+    mark_template->Set(index_symbol,  Integer::New(0));
+    mark_template->Set(line_symbol,   Integer::New(0));
+    mark_template->Set(column_symbol, Integer::New(0));
+    fly.start = mark_template->NewInstance();
+    fly.end   = mark_template->NewInstance();
+  }
+}
+
+
+// Base64, as used by `!!binary` scalars.
+static const char base64_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Encoded character pairs for every 12-bit value, so that three bytes are encoded with two
+// lookups.
+static char base64_pairs[4096][2];
+
+// Decoded values for every character. Anything above 63 is not part of a quad.
+enum {
+  BASE64_SPACE   = 0x80,
+  BASE64_PADDING = 0x81,
+  BASE64_INVALID = 0xFF
+};
+static uint8_t base64_values[256];
+
+// Fill the lookup tables. Called once, when the module is loaded.
+static void
+InitializeBase64()
+{
+  for (int i = 0; i < 4096; i++) {
+    base64_pairs[i][0] = base64_alphabet[i >> 6];
+    base64_pairs[i][1] = base64_alphabet[i & 63];
+  }
+
+  memset(base64_values, BASE64_INVALID, sizeof(base64_values));
+  for (int i = 0; i < 64; i++)
+    base64_values[(uint8_t)base64_alphabet[i]] = (uint8_t)i;
+  base64_values[(uint8_t)' ']  = BASE64_SPACE;
+  base64_values[(uint8_t)'\t'] = BASE64_SPACE;
+  base64_values[(uint8_t)'\r'] = BASE64_SPACE;
+  base64_values[(uint8_t)'\n'] = BASE64_SPACE;
+  base64_values[(uint8_t)'=']  = BASE64_PADDING;
+}
+
+// Encode data as base64, with a line break after every `line_length` characters. The line
+// length must be a multiple of four.
+static void
+EncodeBase64(const uint8_t *data, size_t length, size_t line_length, std::string &output)
+{
+  size_t encoded_length = (length + 2) / 3 * 4;
+  size_t num_breaks = encoded_length ? (encoded_length - 1) / line_length : 0;
+  output.resize(encoded_length + num_breaks);
+  if (encoded_length == 0)
+    return;
+
+  char *out = &output[0];
+  size_t line_bytes = line_length / 4 * 3;
+  const uint8_t *end = data + length;
+  while (data != end) {
+    // Whole groups of three bytes on this line.
+    size_t available = (size_t)(end - data);
+    const uint8_t *line_end = data + (available < line_bytes ? available : line_bytes);
+    for (; line_end - data >= 3; data += 3, out += 4) {
+      uint32_t group = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+      memcpy(out,     base64_pairs[group >> 12],   2);
+      memcpy(out + 2, base64_pairs[group & 0xFFF], 2);
+    }
+
+    // A final partial group, with padding.
+    if (data != line_end) {
+      uint32_t group = (uint32_t)data[0] << 16;
+      if (line_end - data == 2)
+        group |= (uint32_t)data[1] << 8;
+      memcpy(out, base64_pairs[group >> 12], 2);
+      out[2] = line_end - data == 2 ? base64_pairs[group & 0xFFF][0] : '=';
+      out[3] = '=';
+      data = line_end;
+      out += 4;
+    }
+
+    if (data != end)
+      *out++ = '\n';
+  }
+}
+
+// Decode base64, ignoring whitespace. The output must have room for `length / 4 * 3 + 2` bytes.
+// Returns false if the input is not valid base64.
+static bool
+DecodeBase64(const char *input, size_t length, uint8_t *output, size_t &output_length)
+{
+  const uint8_t *in = (const uint8_t *)input;
+  const uint8_t *end = in + length;
+  uint8_t *out = output;
+
+  // Bits of a partial quad, and the number of characters in it.
+  uint32_t quad = 0;
+  int num_chars = 0;
+
+  while (in != end) {
+    // Decode whole quads at once, as long as they contain no whitespace or padding. Any character
+    // that is not part of a quad has the high bit set, so a single test checks all four.
+    if (num_chars == 0) {
+      while (end - in >= 4) {
+        uint32_t a = base64_values[in[0]], b = base64_values[in[1]],
+                 c = base64_values[in[2]], d = base64_values[in[3]];
+        if ((a | b | c | d) & 0x80)
+          break;
+        uint32_t group = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = (uint8_t)(group >> 16);
+        out[1] = (uint8_t)(group >> 8);
+        out[2] = (uint8_t)group;
+        in += 4;
+        out += 3;
+      }
+      if (in == end)
+        break;
+    }
+
+    // Otherwise, take a single character.
+    uint8_t value = base64_values[*in++];
+    if (value < 64) {
+      quad = (quad << 6) | value;
+      if (++num_chars == 4) {
+        out[0] = (uint8_t)(quad >> 16);
+        out[1] = (uint8_t)(quad >> 8);
+        out[2] = (uint8_t)quad;
+        out += 3;
+        quad = 0;
+        num_chars = 0;
+      }
+    }
+    else if (value == BASE64_PADDING) {
+      // Only padding and whitespace may follow.
+      for (; in != end; in++) {
+        if (base64_values[*in] != BASE64_SPACE && base64_values[*in] != BASE64_PADDING)
+          return false;
+      }
+    }
+    else if (value != BASE64_SPACE) {
+      return false;
+    }
+  }
+
+  // Flush a partial quad.
+  switch (num_chars) {
+    case 1:
+      return false;
+    case 2:
+      *out++ = (uint8_t)(quad >> 4);
+      break;
+    case 3:
+      *out++ = (uint8_t)(quad >> 10);
+      *out++ = (uint8_t)(quad >> 2);
+      break;
+  }
+
+  output_length = (size_t)(out - output);
+  return true;
+}
+
+// Get the contents of a Buffer or Uint8Array.
+static bool
+GetByteArrayData(Local<Value> value, const uint8_t *&data, size_t &length)
+{
+  if (!value->IsObject())
+    return false;
+  Local<Object> obj = Local<Object>::Cast(value);
+  if (!obj->HasIndexedPropertiesInExternalArrayData())
+    return false;
+
+  ExternalArrayType type = obj->GetIndexedPropertiesExternalArrayDataType();
+  if (type != kExternalUnsignedByteArray && type != kExternalPixelArray)
+    return false;
+
+  data = (const uint8_t *)obj->GetIndexedPropertiesExternalArrayData();
+  length = (size_t)obj->GetIndexedPropertiesExternalArrayDataLength();
+  return true;
+}
+
 
 // Create a LibYAML event from an input object.
 static inline yaml_event_t *
@@ -236,6 +640,19 @@ JsToEvent(Local<Object> &obj)
 
   else if (type->StrictEquals(scalar_symbol)) {
     Local<Value> tmp = obj->Get(value_symbol);
+
+    // Binary data is encoded as a `!!binary` literal.
+    const uint8_t *data;
+    size_t length;
+    if (GetByteArrayData(tmp, data, length)) {
+      std::string encoded;
+      EncodeBase64(data, length, 76, encoded);
+      yaml_scalar_event_initialize(event, NULL, (yaml_char_t *)"tag:yaml.org,2002:binary",
+          (yaml_char_t *)encoded.data(), (int)encoded.size(),
+          0, 0, YAML_LITERAL_SCALAR_STYLE);
+      goto end;
+    }
+
     if (!tmp->IsString()) goto end;
     String::Utf8Value value(tmp);
 
@@ -291,6 +708,7 @@ ParserErrorToJs(yaml_parser_t &parser)
 
     case YAML_SCANNER_ERROR:
     case YAML_PARSER_ERROR:
+    case YAML_COMPOSER_ERROR:
       if (parser.context != NULL) {
         problem = String::Concat(problem, String::New(", "));
         problem = String::Concat(problem, String::New(parser.context));
@@ -335,62 +753,176 @@ EmitterErrorToJs(yaml_emitter_t &emitter)
 }
 
 
+// Map an event property name to its `FIELD_*` flag, or 0 if it is unknown.
+static int
+FieldToFlag(Local<Value> name)
+{
+  if (name->StrictEquals(type_symbol))            return FIELD_TYPE;
+  if (name->StrictEquals(start_symbol))           return FIELD_START;
+  if (name->StrictEquals(end_symbol))             return FIELD_END;
+  if (name->StrictEquals(version_symbol))         return FIELD_VERSION;
+  if (name->StrictEquals(implicit_symbol))        return FIELD_IMPLICIT;
+  if (name->StrictEquals(anchor_symbol))          return FIELD_ANCHOR;
+  if (name->StrictEquals(tag_symbol))             return FIELD_TAG;
+  if (name->StrictEquals(value_symbol))           return FIELD_VALUE;
+  if (name->StrictEquals(plain_implicit_symbol))  return FIELD_PLAIN_IMPLICIT;
+  if (name->StrictEquals(quoted_implicit_symbol)) return FIELD_QUOTED_IMPLICIT;
+  if (name->StrictEquals(style_symbol))           return FIELD_STYLE;
+  return 0;
+}
+
+
+// Initialize a parser reading from a string converted with `String::Value`, which must outlive
+// the parser.
+static bool
+InitializeParser(yaml_parser_t &parser, String::Value &value)
+{
+  const uint16_t *input = *value;
+  size_t size = value.length();
+
+  // Strip the BOM.
+  if (size != 0 && input[0] == 0xFEFF) {
+    input++;
+    size--;
+  }
+
+  // LibYAML expects a UTF-16 character array.
+  const unsigned char *string = (const unsigned char *)input;
+  size *= sizeof(uint16_t);
+
+  if (!yaml_parser_initialize(&parser))
+    return false;
+  // FIXME: Detect endianness?
+  yaml_parser_set_encoding(&parser, YAML_UTF16LE_ENCODING);
+  yaml_parser_set_input_string(&parser, string, size);
+  return true;
+}
+
+
 // Binding to LibYAML's stream parser. The function signature is:
 //
-//     parse(input, handler);
+//     parse(input, handler, [options]);
+//
+// Where `input` is a string, and `handler` is either a function receiving all events, or an
+// object with methods named after events, eg. `onScalar` and `onMappingStart`. The methods are
+// looked up once, before parsing starts. If a handler returns `false`, parsing stops, and
+// `parse` returns `false` instead of `true`.
+//
+// The optional `options` object may contain:
 //
-// Where `input` is a string, and `handler` is a function receiving events.
+//  - `marks`: either `'full'` (the default), or `'index'` to have the `start` and `end` of
+//    events be plain character indices instead of `{ index, line, column }` objects.
+//
+//  - `fields`: an array of event property names to set, eg. `['type', 'value']`. By default,
+//    all properties are set.
+//
+//  - `flyweight`: if true, the same event object is passed to the handler every time, with its
+//    properties overwritten. Properties that don't apply to an event are then `null`.
 static Handle<Value>
 Parse(const Arguments &args)
 {
   HandleScope scope;
 
   // Check arguments.
-  if (args.Length() != 2)
+  if (args.Length() != 2 && args.Length() != 3)
     return ThrowException(Exception::Error(
-        String::New("Two arguments were expected.")));
+        String::New("Two or three arguments were expected.")));
   if (!args[0]->IsString())
     return ThrowException(Exception::TypeError(
         String::New("Input must be a string.")));
-  if (!args[1]->IsFunction())
+  if (!args[1]->IsObject())
     return ThrowException(Exception::TypeError(
-        String::New("Handler must be a function.")));
+        String::New("Handler must be a function or an object.")));
+  if (args.Length() == 3 && !args[2]->IsUndefined() && !args[2]->IsObject())
+    return ThrowException(Exception::TypeError(
+        String::New("Options must be an object.")));
+
+  // Read options.
+  int flags = FIELD_ALL;
+  if (args.Length() == 3 && args[2]->IsObject()) {
+    Local<Object> options = Local<Object>::Cast(args[2]);
+    if (options->Get(marks_symbol)->StrictEquals(index_symbol))
+      flags |= INDEX_MARKS;
+    if (options->Get(flyweight_symbol)->BooleanValue())
+      flags |= FLYWEIGHT;
+
+    Local<Value> fields = options->Get(fields_symbol);
+    if (fields->IsArray()) {
+      Local<Array> array = Local<Array>::Cast(fields);
+      uint32_t length = array->Length();
+      flags &= ~FIELD_ALL;
+      for (uint32_t i = 0; i < length; i++) {
+        int field = FieldToFlag(array->Get(i));
+        if (field == 0)
+          return ThrowException(Exception::TypeError(String::Concat(
+              String::New("Unknown event field: "), array->Get(i)->ToString())));
+        flags |= field;
+      }
+    }
+    else if (!fields->IsUndefined()) {
+      return ThrowException(Exception::TypeError(
+          String::New("Fields must be an array.")));
+    }
+  }
+  EventToJsFunction event_to_js = SelectEventToJs(flags);
+  Flyweight fly;
+  if (flags & FLYWEIGHT)
+    CreateFlyweight(fly, flags);
 
   // Dereference arguments.
   String::Value value(args[0]);
-  const uint16_t *input = *value;
-  size_t size = value.length();
-  Local<Function> handler = Local<Function>::Cast(args[1]);
 
-  // Strip the BOM.
-  if (size != 0 && input[0] == 0xFEFF) {
-    input++;
-    size--;
+  // Resolve the handler methods up front. An event without a method is skipped entirely.
+  Local<Object> receiver;
+  Local<Value> methods[YAML_MAPPING_END_EVENT + 1];
+  if (args[1]->IsFunction()) {
+    receiver = Context::GetCurrent()->Global();
+    for (int i = YAML_STREAM_START_EVENT; i <= YAML_MAPPING_END_EVENT; i++)
+      methods[i] = args[1];
+  }
+  else {
+    receiver = Local<Object>::Cast(args[1]);
+    for (int i = YAML_STREAM_START_EVENT; i <= YAML_MAPPING_END_EVENT; i++) {
+      Local<Value> method = receiver->Get(handler_method_symbols[i]);
+      if (method->IsFunction())
+        methods[i] = method;
+    }
   }
-
-  // LibYAML expects a UTF-16 character array.
-  const unsigned char *string = (const unsigned char *)input;
-  size *= sizeof(uint16_t);
 
   // Initialize parser.
   yaml_parser_t parser;
-  if (!yaml_parser_initialize(&parser))
+  if (!InitializeParser(parser, value))
     return ThrowException(Exception::Error(
         String::New("Could not initiaize libYAML")));
-  // FIXME: Detect endianness?
-  yaml_parser_set_encoding(&parser, YAML_UTF16LE_ENCODING);
-  yaml_parser_set_input_string(&parser, string, size);
 
   // Event loop.
   yaml_event_t event;
+  Handle<Value> result = True();
   while (true) {
+    // Handles created for this event are released at the end of the iteration, so memory use
+    // does not grow with the number of events.
+    HandleScope event_scope;
+
     // Get the next event, or throw an exception.
-    if (yaml_parser_parse(&parser, &event) == 0)
-      return ThrowException(ParserErrorToJs(parser));
+    if (yaml_parser_parse(&parser, &event) == 0) {
+      result = ThrowException(ParserErrorToJs(parser));
+      break;
+    }
 
-    // Call the handler method.
-    Local<Value> params[1] = { EventToJs(event) };
-    handler->Call(Context::GetCurrent()->Global(), 1, params);
+    // Call the handler method. It may return `false` to stop parsing.
+    Local<Value> method = methods[event.type];
+    if (!method.IsEmpty()) {
+      Local<Value> params[1] = { event_to_js(event, flags, &fly) };
+      Local<Value> ret = Local<Function>::Cast(method)->Call(receiver, 1, params);
+      if (ret.IsEmpty() || ret->IsFalse()) {
+        yaml_event_delete(&event);
+        if (ret.IsEmpty())
+          result = Handle<Value>();
+        else
+          result = False();
+        break;
+      }
+    }
 
     // Clean up the event.
     if (event.type == YAML_STREAM_END_EVENT) {
@@ -405,87 +937,4012 @@ Parse(const Arguments &args)
   // Clean up the parser.
   yaml_parser_delete(&parser);
 
-  return Undefined();
+  return result;
 }
 
 
-// Binding to LibYAML's stream emitter. The usage is more or less the opposite of `parse`:
-//
-//     var emitter = new Emitter(function(data) { /* ... */ };
-//     emitter.event({ type: 'streamStart' });
-//
-// The constructor takes a function called with output data as LibYAML provides it.
-class Emitter : ObjectWrap
+// Record types on a tape. Documents and collections start with their own record, and end with a
+// `RECORD_END`, much like the parser events they are created from. Scalars are resolved to one
+// of the types from `RECORD_NULL` onwards.
+enum {
+  RECORD_DOCUMENT,
+  RECORD_SEQUENCE,
+  RECORD_MAPPING,
+  RECORD_END,
+  RECORD_ALIAS,
+  RECORD_NULL,
+  RECORD_FALSE,
+  RECORD_TRUE,
+  RECORD_NUMBER,
+  RECORD_TIMESTAMP,
+  RECORD_STRING,
+  RECORD_BINARY,
+  RECORD_EXTERNAL_STRING
+};
+
+// Record flags.
+enum {
+  RECORD_ANCHORED = 1 << 0
+};
+
+// Helpers for scalar resolution. These work on the UTF-8 values LibYAML produces, and follow
+// the YAML 1.1 types at http://yaml.org/type/, with some cues from tenderlove's
+// `Psych::ScalarScanner`. (MIT-licensed)
+static inline bool
+IsDigit(char c)
 {
-public:
-  static void
-  Initialize(Handle<Object> target)
-  {
-    Local<FunctionTemplate> t = FunctionTemplate::New(New);
-    t->InstanceTemplate()->SetInternalFieldCount(1);
+  return c >= '0' && c <= '9';
+}
 
-    NODE_SET_PROTOTYPE_METHOD(t, "event", Event);
+static inline bool
+IsSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
 
-    target->Set(String::NewSymbol("Emitter"), t->GetFunction());
-  }
+static inline int
+HexDigitValue(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
 
-  virtual
-  ~Emitter()
-  {
-    writeCallback_.Dispose();
-    yaml_emitter_delete(&emitter_);
+// Compare a value to a lowercase keyword, ignoring case.
+static bool
+EqualsKeyword(const char *value, size_t length, const char *keyword)
+{
+  size_t i;
+  for (i = 0; i < length; i++) {
+    char c = value[i];
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+    if (keyword[i] != c)
+      return false;
   }
+  return keyword[i] == '\0';
+}
 
-private:
-  Emitter() {}
-
-  static Handle<Value>
-  New(const Arguments &args)
-  {
-    if (args.Length() != 1)
-      return ThrowException(Exception::TypeError(
-          String::New("Expected one argument")));
-    if (!args[0]->IsFunction())
-      return ThrowException(Exception::TypeError(
-          String::New("Expected a function")));
+// Decimal digits, read straight from a scalar.
+struct DecimalDigits {
+  // The significant digits, as long as there are no more than 19.
+  uint64_t mantissa;
 
-    Emitter *e = new Emitter();
+  // The number of significant digits.
+  int num_digits;
 
-    if (!yaml_emitter_initialize(&e->emitter_))
-      return ThrowException(Exception::Error(
-          String::New("Could not initiaize libYAML")));
-    // FIXME: Detect endianness?
-    yaml_emitter_set_encoding(&e->emitter_, YAML_UTF16LE_ENCODING);
-    // Don't escape unicode in output
-    yaml_emitter_set_unicode(&e->emitter_, 1);
-    yaml_emitter_set_output(&e->emitter_, WriteHandler, e);
+  // The power of ten to scale the mantissa by.
+  int exponent;
 
-    e->writeCallback_ = Persistent<Function>::New(
-        Handle<Function>::Cast(args[0]));
+  // Whether any digits were read at all, including leading zeros.
+  bool any;
+};
 
-    e->Wrap(args.This());
-    return e->handle_;
-  }
+// Load eight bytes as a little-endian integer, regardless of the host byte order. Compilers
+// turn this into a single load on little-endian machines.
+static inline uint64_t
+LoadEightBytes(const char *value)
+{
+  const uint8_t *bytes = (const uint8_t *)value;
+  return (uint64_t)bytes[0]         | ((uint64_t)bytes[1] << 8)
+      | ((uint64_t)bytes[2] << 16) | ((uint64_t)bytes[3] << 24)
+      | ((uint64_t)bytes[4] << 32) | ((uint64_t)bytes[5] << 40)
+      | ((uint64_t)bytes[6] << 48) | ((uint64_t)bytes[7] << 56);
+}
 
-  static Handle<Value>
-  Event(const Arguments &args)
-  {
-    if (args.Length() != 1)
-      return ThrowException(Exception::TypeError(
-          String::New("Expected one argument")));
-    if (!args[0]->IsObject())
-      return ThrowException(Exception::TypeError(
-          String::New("Expected an object")));
-    Local<Object> obj = Local<Object>::Cast(args[0]);
+// Check whether eight bytes are all ASCII digits.
+static inline bool
+IsEightDigits(uint64_t chunk)
+{
+  return ((chunk & 0xF0F0F0F0F0F0F0F0ULL)
+      | (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+      == 0x3333333333333333ULL;
+}
 
-    Emitter *e = ObjectWrap::Unwrap<Emitter>(args.This());
+// Convert eight ASCII digits at once, by combining pairs, then quads, then the two halves.
+static inline uint32_t
+ParseEightDigits(uint64_t chunk)
+{
+  chunk -= 0x3030303030303030ULL;
+  chunk = chunk * 10 + (chunk >> 8);
+  chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+      + (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+  return (uint32_t)chunk;
+}
 
-    yaml_event_t *ev = JsToEvent(obj);
-    if (yaml_emitter_emit(&e->emitter_, ev) == 0)
-      return ThrowException(EmitterErrorToJs(e->emitter_));
+// Read a run of digits into the mantissa, skipping underscores. Digits are taken eight at a time
+// where possible. Returns the index of the first character that is not a digit or underscore.
+static size_t
+ScanDigits(const char *value, size_t length, size_t i, DecimalDigits &digits, bool fraction)
+{
+  while (i < length) {
+    char c = value[i];
+    if (c == '_') {
+      i++;
+      continue;
+    }
+    if (!IsDigit(c))
+      break;
+    digits.any = true;
 
-    return Undefined();
-  }
+    // Leading zeros only matter in the fraction, where they shift the exponent.
+    if (c == '0' && digits.num_digits == 0) {
+      if (fraction)
+        digits.exponent--;
+      i++;
+      continue;
+    }
+
+    if (digits.num_digits <= 11 && length - i >= 8) {
+      uint64_t chunk = LoadEightBytes(value + i);
+      if (IsEightDigits(chunk)) {
+        digits.mantissa = digits.mantissa * 100000000 + ParseEightDigits(chunk);
+        digits.num_digits += 8;
+        if (fraction)
+          digits.exponent -= 8;
+        i += 8;
+        continue;
+      }
+    }
+
+    if (digits.num_digits < 19) {
+      digits.mantissa = digits.mantissa * 10 + (c - '0');
+      if (fraction)
+        digits.exponent--;
+    }
+    digits.num_digits++;
+    i++;
+  }
+  return i;
+}
+
+// Convert digits exactly, if both the mantissa and the power of ten are exact doubles, so that a
+// single multiplication or division rounds correctly. (Clinger's fast path.) This needs plain
+// double precision arithmetic, which rules out the x87 FPU.
+static bool
+FastDecimal(const DecimalDigits &digits, double &out)
+{
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+  return false;
+#else
+  static const double powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  static const uint64_t max_mantissa = 1ULL << 53;
+
+  if (digits.num_digits > 19)
+    return false;
+  uint64_t mantissa = digits.mantissa;
+  int exponent = digits.exponent;
+  if (mantissa == 0) {
+    out = 0;
+    return true;
+  }
+  if (mantissa > max_mantissa || exponent < -22)
+    return false;
+
+  // A larger exponent still works if part of it can be moved into the mantissa.
+  for (; exponent > 22; exponent--) {
+    mantissa *= 10;
+    if (mantissa > max_mantissa)
+      return false;
+  }
+
+  if (exponent < 0)
+    out = (double)mantissa / powers_of_ten[-exponent];
+  else
+    out = (double)mantissa * powers_of_ten[exponent];
+  return true;
+#endif
+}
+
+// Convert a decimal number with an optional sign, fraction and exponent. Underscores are skipped.
+// Like JavaScript's `parseFloat`, this stops at the first character that doesn't fit, and
+// results in NaN if there are no digits at all.
+static double
+ParseDecimal(const char *value, size_t length)
+{
+  size_t i = 0;
+  bool negative = false;
+  if (i < length && (value[i] == '-' || value[i] == '+'))
+    negative = value[i++] == '-';
+
+  DecimalDigits digits = { 0, 0, 0, false };
+  i = ScanDigits(value, length, i, digits, false);
+  if (i < length && value[i] == '.')
+    i = ScanDigits(value, length, i + 1, digits, true);
+  if (!digits.any)
+    return std::numeric_limits<double>::quiet_NaN();
+
+  // An exponent without digits is left out, like `parseFloat` does.
+  if (i < length && (value[i] == 'e' || value[i] == 'E')) {
+    size_t j = i + 1;
+    bool negative_exponent = false;
+    if (j < length && (value[j] == '-' || value[j] == '+'))
+      negative_exponent = value[j++] == '-';
+    if (j < length && IsDigit(value[j])) {
+      int exponent = 0;
+      for (; j < length && IsDigit(value[j]); j++) {
+        if (exponent < 100000)
+          exponent = exponent * 10 + (value[j] - '0');
+      }
+      digits.exponent += negative_exponent ? -exponent : exponent;
+      i = j;
+    }
+  }
+
+  double result;
+  if (FastDecimal(digits, result))
+    return negative ? -result : result;
+
+  // Otherwise, leave it to `strtod`, which is slower, but always rounds correctly.
+  char buffer[64];
+  std::string large;
+  char *string = buffer;
+  if (i >= sizeof(buffer)) {
+    large.resize(i + 1);
+    string = &large[0];
+  }
+  size_t string_length = 0;
+  for (size_t j = 0; j < i; j++) {
+    if (value[j] != '_')
+      string[string_length++] = value[j];
+  }
+  string[string_length] = '\0';
+  return strtod(string, NULL);
+}
+
+static bool
+ResolveNull(const char *value, size_t length)
+{
+  return length == 0
+      || (length == 1 && value[0] == '~')
+      || EqualsKeyword(value, length, "null");
+}
+
+static bool
+ResolveBool(const char *value, size_t length, bool &out)
+{
+  if (EqualsKeyword(value, length, "y") || EqualsKeyword(value, length, "yes")
+      || EqualsKeyword(value, length, "true") || EqualsKeyword(value, length, "on")) {
+    out = true;
+    return true;
+  }
+  if (EqualsKeyword(value, length, "n") || EqualsKeyword(value, length, "no")
+      || EqualsKeyword(value, length, "false") || EqualsKeyword(value, length, "off")) {
+    out = false;
+    return true;
+  }
+  return false;
+}
+
+// Infinity and NaN.
+static bool
+ResolveSpecialFloat(const char *value, size_t length, double &out)
+{
+  if (EqualsKeyword(value, length, ".inf") || EqualsKeyword(value, length, "+.inf"))
+    out = std::numeric_limits<double>::infinity();
+  else if (EqualsKeyword(value, length, "-.inf"))
+    out = -std::numeric_limits<double>::infinity();
+  else if (EqualsKeyword(value, length, ".nan"))
+    out = std::numeric_limits<double>::quiet_NaN();
+  else
+    return false;
+  return true;
+}
+
+// Binary integers: `[-+]?0b[01_]+`.
+static bool
+ResolveBinary(const char *value, size_t length, double &out)
+{
+  size_t i = 0;
+  bool negative = false;
+  if (i < length && (value[i] == '-' || value[i] == '+'))
+    negative = value[i++] == '-';
+  if (length - i < 3 || value[i] != '0' || value[i + 1] != 'b')
+    return false;
+
+  double result = 0;
+  for (i += 2; i < length; i++) {
+    char c = value[i];
+    if (c == '_')
+      continue;
+    if (c != '0' && c != '1')
+      return false;
+    result = result * 2 + (c - '0');
+  }
+  out = negative ? -result : result;
+  return true;
+}
+
+// Integers in other bases, with underscores. Results in NaN if there are no digits at all.
+static double
+ParseRadix(const char *value, size_t length, int base)
+{
+  double result = 0;
+  bool any = false;
+  for (size_t i = 0; i < length; i++) {
+    if (value[i] == '_')
+      continue;
+    int digit = HexDigitValue(value[i]);
+    if (digit < 0 || digit >= base)
+      break;
+    result = result * base + digit;
+    any = true;
+  }
+  return any ? result : std::numeric_limits<double>::quiet_NaN();
+}
+
+// Other integers: `[-+]?(0x[0-9a-fA-F_]+|0o[0-7_]+|[0-9_]+)`. Other numbers starting with a
+// zero are octal as well.
+static bool
+ResolveInt(const char *value, size_t length, double &out)
+{
+  size_t i = 0;
+  bool negative = false;
+  if (i < length && (value[i] == '-' || value[i] == '+'))
+    negative = value[i++] == '-';
+
+  int base = 10;
+  if (length - i > 2 && value[i] == '0' && (value[i + 1] == 'x' || value[i + 1] == 'o')) {
+    base = value[i + 1] == 'x' ? 16 : 8;
+    i += 2;
+  }
+  if (i == length)
+    return false;
+  for (size_t j = i; j < length; j++) {
+    int digit = HexDigitValue(value[j]);
+    if (value[j] != '_' && (digit < 0 || digit >= base))
+      return false;
+  }
+
+  double result;
+  if (base != 10) {
+    result = ParseRadix(value + i, length - i, base);
+  }
+  else {
+    // A leading zero followed by more digits means octal. Like `parseInt`, this stops at the
+    // first digit that is not octal.
+    size_t first = i, next;
+    for (; first < length && value[first] == '_'; first++);
+    for (next = first + 1; next < length && value[next] == '_'; next++);
+    if (next < length && value[first] == '0')
+      result = ParseRadix(value + first, length - first, 8);
+    else
+      result = ParseDecimal(value + i, length - i);
+  }
+  out = negative ? -result : result;
+  return true;
+}
+
+// Floats: `[-+]?([0-9][0-9_]*)?\.[0-9_]*([eE][-+][0-9]+)?`.
+static bool
+ResolveFloat(const char *value, size_t length, double &out)
+{
+  size_t i = 0;
+  if (i < length && (value[i] == '-' || value[i] == '+'))
+    i++;
+  if (i < length && IsDigit(value[i])) {
+    for (i++; i < length && (IsDigit(value[i]) || value[i] == '_'); i++);
+  }
+  if (i == length || value[i] != '.')
+    return false;
+  for (i++; i < length && (IsDigit(value[i]) || value[i] == '_'); i++);
+  if (i < length) {
+    if (value[i] != 'e' && value[i] != 'E')
+      return false;
+    if (++i == length || (value[i] != '-' && value[i] != '+'))
+      return false;
+    if (++i == length)
+      return false;
+    for (; i < length; i++) {
+      if (!IsDigit(value[i]))
+        return false;
+    }
+  }
+
+  out = ParseDecimal(value, length);
+  return true;
+}
+
+// Sexagesimal numbers: `[-+]?[0-9][0-9_]*(:[0-5]?[0-9])+(\.[0-9_]*)?`. Like the JavaScript
+// implementation this replaces, only the last part may have a fraction, and each part ends
+// at its first underscore.
+static bool
+ResolveSexagesimal(const char *value, size_t length, double &out)
+{
+  size_t i = 0;
+  bool negative = false;
+  if (i < length && (value[i] == '-' || value[i] == '+'))
+    negative = value[i++] == '-';
+  if (i == length || !IsDigit(value[i]))
+    return false;
+
+  // Validate, and find where the last part starts.
+  size_t j = i + 1, last = 0;
+  for (; j < length && (IsDigit(value[j]) || value[j] == '_'); j++);
+  int groups = 0;
+  while (j < length && value[j] == ':') {
+    last = ++j;
+    if (j < length && value[j] >= '0' && value[j] <= '5' && j + 1 < length && IsDigit(value[j + 1]))
+      j += 2;
+    else if (j < length && IsDigit(value[j]))
+      j += 1;
+    else
+      return false;
+    groups++;
+  }
+  if (groups == 0)
+    return false;
+  if (j < length && value[j] == '.') {
+    for (j++; j < length && (IsDigit(value[j]) || value[j] == '_'); j++);
+  }
+  if (j != length)
+    return false;
+
+  double result = 0;
+  while (i < last) {
+    double part = 0;
+    for (; IsDigit(value[i]); i++)
+      part = part * 10 + (value[i] - '0');
+    while (value[i] != ':')
+      i++;
+    i++;
+    result = result * 60 + part;
+  }
+  size_t end = last;
+  for (; end < length && value[end] != '_'; end++);
+  result = result * 60 + ParseDecimal(value + last, end - last);
+
+  out = negative ? -result : result;
+  return true;
+}
+
+// Read 1 to `max` digits as a number.
+static bool
+ReadDigits(const char *value, size_t length, size_t &i, size_t min, size_t max, int &out)
+{
+  size_t start = i;
+  out = 0;
+  while (i < length && i - start < max && IsDigit(value[i]))
+    out = out * 10 + (value[i++] - '0');
+  return i - start >= min;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date.
+static double
+DaysFromCivil(int year, int month, int day)
+{
+  year -= month <= 2;
+  int era = (year >= 0 ? year : year - 399) / 400;
+  int yoe = year - era * 400;
+  int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return (double)era * 146097 + doe - 719468;
+}
+
+// Timestamps, as milliseconds since the epoch. Either a date, `YYYY-MM-DD`, or a date and time
+// separated by `T` or spaces, with an optional fraction and time zone.
+static bool
+ResolveTimestamp(const char *value, size_t length, double &out)
+{
+  size_t i = 0;
+  int year, month, day, hour = 0, minute = 0, second = 0, millis = 0, offset = 0;
+  if (!ReadDigits(value, length, i, 4, 4, year)
+      || i == length || value[i++] != '-'
+      || !ReadDigits(value, length, i, 1, 2, month)
+      || i == length || value[i++] != '-'
+      || !ReadDigits(value, length, i, 1, 2, day))
+    return false;
+
+  if (i != length) {
+    // Separator.
+    if (value[i] == 'T' || value[i] == 't') {
+      i++;
+    }
+    else {
+      size_t start = i;
+      for (; i < length && IsSpace(value[i]); i++);
+      if (i == start)
+        return false;
+    }
+
+    // Time.
+    if (!ReadDigits(value, length, i, 1, 2, hour)
+        || i == length || value[i++] != ':'
+        || !ReadDigits(value, length, i, 2, 2, minute)
+        || i == length || value[i++] != ':'
+        || !ReadDigits(value, length, i, 2, 2, second))
+      return false;
+
+    // Fraction, truncated to milliseconds.
+    if (i < length && value[i] == '.') {
+      int scale = 100;
+      for (i++; i < length && IsDigit(value[i]); i++) {
+        millis += (value[i] - '0') * scale;
+        scale /= 10;
+      }
+    }
+
+    // Time zone.
+    size_t zone = i;
+    for (; i < length && IsSpace(value[i]); i++);
+    if (i == length && i != zone)
+      return false;
+    if (i < length) {
+      if (value[i] == 'Z') {
+        i++;
+      }
+      else if (value[i] == '-' || value[i] == '+') {
+        int sign = value[i++] == '-' ? -1 : 1, hours, minutes = 0;
+        if (!ReadDigits(value, length, i, 1, 2, hours))
+          return false;
+        if (i < length && value[i] == ':') {
+          i++;
+          if (!ReadDigits(value, length, i, 2, 2, minutes))
+            return false;
+        }
+        offset = sign * (hours * 60 + minutes);
+      }
+      if (i != length)
+        return false;
+    }
+  }
+
+  if (month < 1 || month > 12 || day < 1 || day > 31
+      || hour > 23 || minute > 59 || second > 59) {
+    out = std::numeric_limits<double>::quiet_NaN();
+    return true;
+  }
+
+  out = DaysFromCivil(year, month, day) * 86400000.0
+      + ((hour * 60 + minute - offset) * 60 + second) * 1000.0
+      + millis;
+  return true;
+}
+
+
+// Resolve a plain scalar to a record type. The checks happen in the same order as they did in
+// the JavaScript `parseScalar` this replaces. Numbers and timestamps are stored in `number`.
+static int
+ResolveImplicit(const char *value, size_t length, double &number)
+{
+  if (length == 0)
+    return RECORD_NULL;
+
+  // Simple keywords.
+  char first = value[0];
+  if ((first >= 'a' && first <= 'z') || (first >= 'A' && first <= 'Z') || first == '~') {
+    bool boolean;
+    if (length > 5 || strchr("ytonfYTONF~", first) == NULL)
+      return RECORD_STRING;
+    if (ResolveNull(value, length))
+      return RECORD_NULL;
+    if (ResolveBool(value, length, boolean))
+      return boolean ? RECORD_TRUE : RECORD_FALSE;
+    return RECORD_STRING;
+  }
+
+  if (ResolveSpecialFloat(value, length, number)
+      || ResolveBinary(value, length, number))
+    return RECORD_NUMBER;
+  if (ResolveTimestamp(value, length, number))
+    return RECORD_TIMESTAMP;
+  if (ResolveInt(value, length, number)
+      || ResolveFloat(value, length, number)
+      || ResolveSexagesimal(value, length, number))
+    return RECORD_NUMBER;
+
+  return RECORD_STRING;
+}
+
+// Standard tags that determine how a scalar is resolved.
+enum {
+  TAG_OTHER,
+  TAG_STR,
+  TAG_INT,
+  TAG_FLOAT,
+  TAG_BOOL,
+  TAG_NULL,
+  TAG_TIMESTAMP,
+  TAG_BINARY
+};
+
+static int
+StandardTag(const std::string &tag)
+{
+  static const char prefix[] = "tag:yaml.org,2002:";
+  if (tag == "!")
+    return TAG_STR;
+  if (tag.compare(0, sizeof(prefix) - 1, prefix) != 0)
+    return TAG_OTHER;
+
+  std::string name = tag.substr(sizeof(prefix) - 1);
+  if (name == "str")       return TAG_STR;
+  if (name == "int")       return TAG_INT;
+  if (name == "float")     return TAG_FLOAT;
+  if (name == "bool")      return TAG_BOOL;
+  if (name == "null")      return TAG_NULL;
+  if (name == "timestamp") return TAG_TIMESTAMP;
+  if (name == "binary")    return TAG_BINARY;
+  return TAG_OTHER;
+}
+
+// Resolve a scalar to a record type, according to its standard tag, if any. Returns -1 if the
+// value does not match the tag.
+static int
+ResolveScalar(int tag, const char *value, size_t length, double &number)
+{
+  bool boolean;
+  switch (tag) {
+    case TAG_STR:
+      return RECORD_STRING;
+
+    case TAG_INT:
+      if (ResolveBinary(value, length, number)
+          || ResolveInt(value, length, number)
+          || ResolveSexagesimal(value, length, number))
+        return RECORD_NUMBER;
+      return -1;
+
+    case TAG_FLOAT:
+      if (ResolveSpecialFloat(value, length, number)
+          || ResolveFloat(value, length, number)
+          || ResolveInt(value, length, number)
+          || ResolveSexagesimal(value, length, number))
+        return RECORD_NUMBER;
+      return -1;
+
+    case TAG_BOOL:
+      if (ResolveBool(value, length, boolean))
+        return boolean ? RECORD_TRUE : RECORD_FALSE;
+      return -1;
+
+    case TAG_NULL:
+      return ResolveNull(value, length) ? RECORD_NULL : -1;
+
+    case TAG_TIMESTAMP:
+      return ResolveTimestamp(value, length, number) ? RECORD_TIMESTAMP : -1;
+
+    default:
+      return ResolveImplicit(value, length, number);
+  }
+}
+
+
+// A compact form of a parser event.
+struct Record {
+  uint8_t type;
+  uint8_t flags;
+  uint16_t style;
+
+  // Index into the tag table, plus one. Zero if the node has no tag.
+  uint32_t tag;
+
+  // Index of the start mark.
+  uint32_t mark;
+
+  union {
+    // Numbers, and timestamps as milliseconds since the epoch.
+    double number;
+
+    // Strings: the value, as a range in the string pool.
+    struct {
+      uint32_t offset;
+      uint32_t length;
+    } string;
+
+    // Documents and collections: the number of children (pairs for mappings), and the index of
+    // the matching `RECORD_END`.
+    struct {
+      uint32_t count;
+      uint32_t end;
+    } collection;
+
+    // Aliases: the index of the anchored record.
+    uint32_t target;
+
+    // Binary data and long strings: the index of the blob.
+    uint32_t blob;
+  } data;
+};
+
+// Strings at least this long are not copied into the V8 heap, but become external strings.
+static const size_t EXTERNAL_STRING_MIN_LENGTH = 1024;
+
+// A heap block owned by a tape, until it is handed off to a Buffer or an external string.
+struct Blob {
+  char *data;
+  size_t length;
+};
+
+// A parsed stream, in a form that can be walked much faster than LibYAML can parse.
+struct Tape {
+  std::vector<Record> records;
+  std::string strings;
+  std::vector<std::string> tags;
+  std::vector<Blob> blobs;
+
+  // Storage for error messages that quote the input.
+  std::string problem;
+
+  ~Tape()
+  {
+    for (size_t i = 0; i < blobs.size(); i++)
+      free(blobs[i].data);
+  }
+};
+
+
+// A set of mapping keys, to find duplicates. This is an open-addressing hash table with linear
+// probing, which keeps the marks of the keys it holds.
+class KeySet
+{
+public:
+  KeySet() : size_(0) {}
+
+  // Add a key. If the key is already in the set, returns the mark of the existing key instead.
+  const yaml_mark_t *
+  Insert(const std::string &key, const yaml_mark_t &mark)
+  {
+    if ((size_ + 1) * 2 > slots_.size())
+      Grow();
+
+    uint32_t hash = Hash(key);
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+      Slot &slot = slots_[i];
+      if (!slot.used) {
+        slot.used = true;
+        slot.hash = hash;
+        slot.offset = (uint32_t)keys_.size();
+        slot.length = (uint32_t)key.size();
+        slot.mark = mark;
+        keys_.append(key);
+        used_.push_back((uint32_t)i);
+        size_++;
+        return NULL;
+      }
+      if (slot.hash == hash && slot.length == key.size()
+          && memcmp(keys_.data() + slot.offset, key.data(), key.size()) == 0)
+        return &slot.mark;
+    }
+  }
+
+  // Empty the set, keeping its memory for the next mapping.
+  void
+  Clear()
+  {
+    for (size_t i = 0; i < used_.size(); i++)
+      slots_[used_[i]].used = false;
+    used_.clear();
+    keys_.clear();
+    size_ = 0;
+  }
+
+private:
+  struct Slot {
+    bool used;
+    uint32_t hash;
+    uint32_t offset;
+    uint32_t length;
+    yaml_mark_t mark;
+  };
+
+  // FNV-1a.
+  static uint32_t
+  Hash(const std::string &key)
+  {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < key.size(); i++) {
+      hash ^= (uint8_t)key[i];
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  void
+  Grow()
+  {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    Slot empty;
+    empty.used = false;
+    slots_.resize(old.empty() ? 16 : old.size() * 2, empty);
+    used_.clear();
+
+    size_t mask = slots_.size() - 1;
+    for (size_t j = 0; j < old.size(); j++) {
+      if (!old[j].used)
+        continue;
+      size_t i = old[j].hash & mask;
+      while (slots_[i].used)
+        i = (i + 1) & mask;
+      slots_[i] = old[j];
+      used_.push_back((uint32_t)i);
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> used_;
+  std::string keys_;
+  size_t size_;
+};
+
+
+// Appends records for parser events to a tape.
+class TapeWriter
+{
+public:
+  TapeWriter(Tape &tape, bool unique_keys)
+    : tape_(tape), unique_keys_(unique_keys) {}
+
+  // Add an event to the tape. On failure, this sets the parser error, like LibYAML does, and
+  // returns 0.
+  int
+  Write(yaml_parser_t &parser, yaml_event_t &event)
+  {
+    // Clear padding as well, so that compiled tapes of the same input are identical.
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.type = RECORD_NULL;
+    record.mark = (uint32_t)event.start_mark.index;
+
+    const yaml_char_t *anchor = NULL;
+    switch (event.type) {
+      case YAML_DOCUMENT_START_EVENT:
+        // Anchors are scoped to their document.
+        anchors_.clear();
+        record.type = RECORD_DOCUMENT;
+        return Open(record);
+
+      case YAML_SEQUENCE_START_EVENT:
+        record.type = RECORD_SEQUENCE;
+        record.style = event.data.sequence_start.style;
+        record.tag = TagId(event.data.sequence_start.tag);
+        anchor = event.data.sequence_start.anchor;
+        Count();
+        Anchor(record, anchor);
+        return Open(record);
+
+      case YAML_MAPPING_START_EVENT:
+        record.type = RECORD_MAPPING;
+        record.style = event.data.mapping_start.style;
+        record.tag = TagId(event.data.mapping_start.tag);
+        anchor = event.data.mapping_start.anchor;
+        Count();
+        Anchor(record, anchor);
+        return Open(record);
+
+      case YAML_DOCUMENT_END_EVENT:
+      case YAML_SEQUENCE_END_EVENT:
+      case YAML_MAPPING_END_EVENT:
+        record.type = RECORD_END;
+        return Close(record);
+
+      case YAML_SCALAR_EVENT: {
+        const char *value = (const char *)event.data.scalar.value;
+        size_t length = event.data.scalar.length;
+        record.style = event.data.scalar.style;
+        record.tag = TagId(event.data.scalar.tag);
+        int tag = record.tag ? tag_kinds_[record.tag - 1] : TAG_OTHER;
+
+        int type;
+        if (tag == TAG_BINARY)
+          type = Decode(value, length, record);
+        else
+          type = ResolveScalar(tag, value, length, record.data.number);
+        if (type < 0) {
+          parser.error = YAML_COMPOSER_ERROR;
+          parser.context = NULL;
+          parser.problem = "found a scalar that does not match its tag";
+          parser.problem_mark = event.start_mark;
+          return 0;
+        }
+        record.type = (uint8_t)type;
+        if (unique_keys_ && IsKey() && !CheckKey(parser, event, record))
+          return 0;
+
+        if (type == RECORD_STRING && length >= EXTERNAL_STRING_MIN_LENGTH) {
+          // Take over LibYAML's copy of long strings, rather than copy them again.
+          Blob blob;
+          blob.data = (char *)event.data.scalar.value;
+          blob.length = length;
+          event.data.scalar.value = NULL;
+          record.type = RECORD_EXTERNAL_STRING;
+          record.data.blob = (uint32_t)tape_.blobs.size();
+          tape_.blobs.push_back(blob);
+        }
+        else if (type == RECORD_STRING) {
+          record.data.string.offset = (uint32_t)tape_.strings.size();
+          record.data.string.length = (uint32_t)length;
+          tape_.strings.append(value, length);
+        }
+
+        Count();
+        Anchor(record, event.data.scalar.anchor);
+        tape_.records.push_back(record);
+        return 1;
+      }
+
+      case YAML_ALIAS_EVENT: {
+        std::map<std::string, uint32_t>::iterator it =
+            anchors_.find((const char *)event.data.alias.anchor);
+        if (it == anchors_.end()) {
+          parser.error = YAML_COMPOSER_ERROR;
+          parser.context = NULL;
+          parser.problem = "found undefined alias";
+          parser.problem_mark = event.start_mark;
+          return 0;
+        }
+        record.type = RECORD_ALIAS;
+        record.data.target = it->second;
+        Count();
+        tape_.records.push_back(record);
+        return 1;
+      }
+
+      default:
+        return 1;
+    }
+  }
+
+private:
+  // Look up or add a tag in the tag table.
+  uint32_t
+  TagId(const yaml_char_t *tag)
+  {
+    if (tag == NULL)
+      return 0;
+
+    std::string key((const char *)tag);
+    std::map<std::string, uint32_t>::iterator it = tag_ids_.find(key);
+    if (it != tag_ids_.end())
+      return it->second;
+
+    tape_.tags.push_back(key);
+    tag_kinds_.push_back(StandardTag(key));
+    uint32_t id = (uint32_t)tape_.tags.size();
+    tag_ids_[key] = id;
+    return id;
+  }
+
+  // Decode a `!!binary` scalar into a new blob.
+  int
+  Decode(const char *value, size_t length, Record &record)
+  {
+    Blob blob;
+    blob.data = (char *)malloc(length / 4 * 3 + 2);
+    if (blob.data == NULL || !DecodeBase64(value, length, (uint8_t *)blob.data, blob.length)) {
+      free(blob.data);
+      return -1;
+    }
+    record.data.blob = (uint32_t)tape_.blobs.size();
+    tape_.blobs.push_back(blob);
+    return RECORD_BINARY;
+  }
+
+  // Check whether the next node is a mapping key.
+  bool
+  IsKey()
+  {
+    if (open_.empty())
+      return false;
+    Record &parent = tape_.records[open_.back()];
+    return parent.type == RECORD_MAPPING && parent.data.collection.count % 2 == 0;
+  }
+
+  // Add a scalar key to the key set of its mapping. If the mapping already has the same key, this
+  // sets the parser error and returns 0.
+  int
+  CheckKey(yaml_parser_t &parser, yaml_event_t &event, Record &record)
+  {
+    // Keys are compared by their resolved value, so that eg. `1` and `1.0` are the same.
+    key_.assign(1, (char)record.type);
+    switch (record.type) {
+      case RECORD_NUMBER:
+      case RECORD_TIMESTAMP: {
+        double number = record.data.number;
+        if (number != number)
+          return 1;
+        if (number == 0)
+          number = 0;
+        key_.append((const char *)&number, sizeof(number));
+        break;
+      }
+      case RECORD_STRING:
+        key_.append((const char *)event.data.scalar.value, event.data.scalar.length);
+        break;
+      case RECORD_BINARY: {
+        Blob &blob = tape_.blobs[record.data.blob];
+        key_.append(blob.data, blob.length);
+        break;
+      }
+    }
+
+    const yaml_mark_t *first =
+        key_sets_[open_.size() - 1].Insert(key_, event.start_mark);
+    if (first == NULL)
+      return 1;
+
+    // Quote the key in the message, shortening long keys.
+    std::string text((const char *)event.data.scalar.value, event.data.scalar.length);
+    if (text.size() > 64)
+      text = text.substr(0, 61) + "...";
+    tape_.problem = "found duplicate key \"" + text + "\"";
+
+    parser.error = YAML_COMPOSER_ERROR;
+    parser.context = "first defined here";
+    parser.context_mark = *first;
+    parser.problem = tape_.problem.c_str();
+    parser.problem_mark = event.start_mark;
+    return 0;
+  }
+
+  // Remember the record about to be added under its anchor.
+  void
+  Anchor(Record &record, const yaml_char_t *anchor)
+  {
+    if (anchor == NULL)
+      return;
+    record.flags |= RECORD_ANCHORED;
+    anchors_[(const char *)anchor] = (uint32_t)tape_.records.size();
+  }
+
+  // Count a node as a child of the innermost open collection.
+  void
+  Count()
+  {
+    if (!open_.empty())
+      tape_.records[open_.back()].data.collection.count++;
+  }
+
+  int
+  Open(Record &record)
+  {
+    record.data.collection.count = 0;
+    record.data.collection.end = 0;
+    open_.push_back((uint32_t)tape_.records.size());
+    tape_.records.push_back(record);
+
+    // Each open mapping has a key set, reused by later mappings at the same depth.
+    if (unique_keys_ && record.type == RECORD_MAPPING) {
+      if (key_sets_.size() < open_.size())
+        key_sets_.resize(open_.size());
+      key_sets_[open_.size() - 1].Clear();
+    }
+    return 1;
+  }
+
+  int
+  Close(Record &record)
+  {
+    Record &start = tape_.records[open_.back()];
+    open_.pop_back();
+    if (start.type == RECORD_MAPPING)
+      start.data.collection.count /= 2;
+    start.data.collection.end = (uint32_t)tape_.records.size();
+    record.data.collection.count = 0;
+    record.data.collection.end = 0;
+    tape_.records.push_back(record);
+    return 1;
+  }
+
+  Tape &tape_;
+  bool unique_keys_;
+  std::vector<uint32_t> open_;
+  std::vector<KeySet> key_sets_;
+  std::string key_;
+  std::map<std::string, uint32_t> anchors_;
+  std::map<std::string, uint32_t> tag_ids_;
+  std::vector<int> tag_kinds_;
+};
+
+// Reasons to stop parsing early.
+enum {
+  CANCEL_NONE,
+  CANCEL_ABORTED,
+  CANCEL_TIMED_OUT
+};
+
+// Number of events parsed between checks for cancellation.
+static const size_t CANCEL_CHECK_EVENTS = 256;
+
+// Conditions to stop parsing early: an abort flag in the first byte of a Buffer, which is set
+// from JavaScript, and a deadline in `uv_hrtime` units. Either is optional. Both only ever go
+// from unset to set, so threads can check their own copies.
+struct Cancel {
+  const volatile uint8_t *flag;
+  uint64_t deadline;
+  int reason;
+
+  Cancel() : flag(NULL), deadline(0), reason(CANCEL_NONE) {}
+
+  // Check whether parsing should stop, and remember why.
+  bool
+  Check()
+  {
+    if (reason == CANCEL_NONE) {
+      if (flag != NULL && *flag != 0)
+        reason = CANCEL_ABORTED;
+      else if (deadline != 0 && uv_hrtime() >= deadline)
+        reason = CANCEL_TIMED_OUT;
+    }
+    return reason != CANCEL_NONE;
+  }
+
+  // The earlier of the deadline and `other`, where zero is no deadline.
+  uint64_t
+  Earliest(uint64_t other)
+  {
+    return deadline != 0 && (other == 0 || deadline < other) ? deadline : other;
+  }
+};
+
+// Parse all input into a tape. Returns 0 on failure, with the parser error set, or with the
+// reason in `cancel`, if given.
+static int
+ParseToTape(yaml_parser_t &parser, Tape &tape, bool unique_keys, Cancel *cancel = NULL)
+{
+  TapeWriter writer(tape, unique_keys);
+  yaml_event_t event;
+  for (size_t i = 1; ; i++) {
+    if (cancel != NULL && i % CANCEL_CHECK_EVENTS == 0 && cancel->Check())
+      return 0;
+    if (yaml_parser_parse(&parser, &event) == 0)
+      return 0;
+
+    int ok = writer.Write(parser, event);
+    yaml_event_type_t type = event.type;
+    yaml_event_delete(&event);
+    if (!ok)
+      return 0;
+    if (type == YAML_STREAM_END_EVENT)
+      return 1;
+  }
+}
+
+
+// Compiled tapes.
+//
+// A tape can be saved in a compact binary form, and loaded again without parsing. The format is
+// meant for caches on the same machine, so it has the native byte order and record layout, which
+// the header checks. Sections are 8-byte aligned:
+//
+//     header | records | tag ranges | blob ranges | data
+//
+// The data section starts with the string pool, so string records need no adjustment. Tags and
+// blobs follow it.
+static const char TAPE_MAGIC[4] = { 'Y', 'T', 'A', 'P' };
+
+enum {
+  TAPE_FORMAT_VERSION = 1
+};
+
+struct TapeHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t num_records;
+  uint32_t num_tags;
+  uint32_t num_blobs;
+  uint32_t strings_size;
+  uint32_t data_size;
+};
+
+// A range in the data section of a compiled tape.
+struct TapeRange {
+  uint32_t offset;
+  uint32_t length;
+};
+
+static inline size_t
+Align8(size_t size)
+{
+  return (size + 7) & ~(size_t)7;
+}
+
+// Append a range for some data to a compiled tape, and the data itself to the data section.
+static void
+AppendRange(std::string &ranges, std::string &data, const char *value, size_t length)
+{
+  TapeRange range;
+  range.offset = (uint32_t)data.size();
+  range.length = (uint32_t)length;
+  ranges.append((const char *)&range, sizeof(range));
+  data.append(value, length);
+}
+
+// Save a tape in compiled form. A tape with blobs that were handed off cannot be saved.
+static void
+CompileTape(Tape &tape, std::string &output)
+{
+  std::string ranges, data(tape.strings);
+  for (size_t i = 0; i < tape.tags.size(); i++)
+    AppendRange(ranges, data, tape.tags[i].data(), tape.tags[i].size());
+  for (size_t i = 0; i < tape.blobs.size(); i++)
+    AppendRange(ranges, data, tape.blobs[i].data, tape.blobs[i].length);
+
+  TapeHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TAPE_MAGIC, sizeof(TAPE_MAGIC));
+  header.version = TAPE_FORMAT_VERSION;
+  header.record_size = sizeof(Record);
+  header.num_records = (uint32_t)tape.records.size();
+  header.num_tags = (uint32_t)tape.tags.size();
+  header.num_blobs = (uint32_t)tape.blobs.size();
+  header.strings_size = (uint32_t)tape.strings.size();
+  header.data_size = (uint32_t)data.size();
+
+  size_t records_size = tape.records.size() * sizeof(Record);
+  output.reserve(sizeof(header) + records_size + Align8(ranges.size()) + data.size());
+  output.append((const char *)&header, sizeof(header));
+  if (records_size != 0)
+    output.append((const char *)&tape.records[0], records_size);
+  output.append(ranges);
+  output.resize(Align8(output.size()), '\0');
+  output.append(data);
+}
+
+// Check that records are properly nested, and refer only to what is on the tape. Builders trust
+// the structure of a tape, so compiled tapes are checked before use.
+static bool
+CheckRecords(const Record *records, uint32_t size, const TapeHeader &header)
+{
+  std::vector<uint32_t> open, children;
+  for (uint32_t i = 0; i < size; i++) {
+    const Record &record = records[i];
+    if (record.tag > header.num_tags)
+      return false;
+
+    // Everything but documents is inside a document, and counts as a child of its parent.
+    if (open.empty() != (record.type == RECORD_DOCUMENT))
+      return false;
+    if (record.type != RECORD_DOCUMENT && record.type != RECORD_END)
+      children.back()++;
+
+    switch (record.type) {
+      case RECORD_DOCUMENT:
+      case RECORD_SEQUENCE:
+      case RECORD_MAPPING:
+        if (record.data.collection.end <= i || record.data.collection.end >= size)
+          return false;
+        open.push_back(i);
+        children.push_back(0);
+        break;
+
+      case RECORD_END: {
+        const Record &start = records[open.back()];
+        uint32_t count = start.data.collection.count;
+        if (start.type == RECORD_MAPPING)
+          count *= 2;
+        if (start.data.collection.end != i || children.back() != count)
+          return false;
+        // Documents have exactly one root node.
+        if (start.type == RECORD_DOCUMENT && count != 1)
+          return false;
+        open.pop_back();
+        children.pop_back();
+        break;
+      }
+
+      case RECORD_ALIAS: {
+        // Aliases refer to an earlier node of the same document.
+        if (record.data.target >= i || record.data.target <= open.front())
+          return false;
+        const Record &target = records[record.data.target];
+        if (!(target.flags & RECORD_ANCHORED) || target.type == RECORD_DOCUMENT
+            || target.type == RECORD_END)
+          return false;
+        break;
+      }
+
+      case RECORD_STRING:
+        if (record.data.string.offset > header.strings_size ||
+            record.data.string.length > header.strings_size - record.data.string.offset)
+          return false;
+        break;
+
+      case RECORD_BINARY:
+      case RECORD_EXTERNAL_STRING:
+        if (record.data.blob >= header.num_blobs)
+          return false;
+        break;
+
+      case RECORD_NULL:
+      case RECORD_FALSE:
+      case RECORD_TRUE:
+      case RECORD_NUMBER:
+      case RECORD_TIMESTAMP:
+        break;
+
+      default:
+        return false;
+    }
+  }
+  return open.empty();
+}
+
+// Check the header of a compiled tape, and find its sections. Returns false if the input is not
+// a compiled tape for this build.
+static bool
+CheckCompiledHeader(const char *input, size_t length, TapeHeader &header,
+    size_t &ranges_offset, size_t &data_offset)
+{
+  if (length < sizeof(header))
+    return false;
+  memcpy(&header, input, sizeof(header));
+  if (memcmp(header.magic, TAPE_MAGIC, sizeof(TAPE_MAGIC)) != 0 ||
+      header.version != TAPE_FORMAT_VERSION || header.record_size != sizeof(Record))
+    return false;
+
+  uint64_t records_size = (uint64_t)header.num_records * sizeof(Record);
+  uint64_t ranges_size = ((uint64_t)header.num_tags + header.num_blobs) * sizeof(TapeRange);
+  uint64_t end = sizeof(header) + records_size + Align8((size_t)ranges_size) + header.data_size;
+  if (end != length || header.strings_size > header.data_size)
+    return false;
+
+  ranges_offset = sizeof(header) + (size_t)records_size;
+  data_offset = ranges_offset + Align8((size_t)ranges_size);
+  return true;
+}
+
+static inline bool
+CheckRange(const TapeRange &range, const TapeHeader &header)
+{
+  return range.offset <= header.data_size && range.length <= header.data_size - range.offset;
+}
+
+// Load a compiled tape. Returns false if the input is not a valid compiled tape for this build.
+static bool
+LoadCompiledTape(const char *input, size_t length, Tape &tape)
+{
+  TapeHeader header;
+  size_t ranges_offset, data_offset;
+  if (!CheckCompiledHeader(input, length, header, ranges_offset, data_offset))
+    return false;
+
+  // Everything is copied out before use, because the input may not be aligned.
+  std::vector<TapeRange> ranges(header.num_tags + header.num_blobs);
+  if (!ranges.empty())
+    memcpy(&ranges[0], input + ranges_offset, ranges.size() * sizeof(TapeRange));
+  for (size_t i = 0; i < ranges.size(); i++) {
+    if (!CheckRange(ranges[i], header))
+      return false;
+  }
+
+  tape.records.resize(header.num_records);
+  if (header.num_records != 0) {
+    memcpy(&tape.records[0], input + sizeof(header), header.num_records * sizeof(Record));
+    if (!CheckRecords(&tape.records[0], header.num_records, header))
+      return false;
+  }
+
+  const char *data = input + data_offset;
+  tape.strings.assign(data, header.strings_size);
+  tape.tags.resize(header.num_tags);
+  for (uint32_t i = 0; i < header.num_tags; i++)
+    tape.tags[i].assign(data + ranges[i].offset, ranges[i].length);
+  tape.blobs.resize(header.num_blobs);
+  for (uint32_t i = 0; i < header.num_blobs; i++) {
+    const TapeRange &range = ranges[header.num_tags + i];
+    Blob &blob = tape.blobs[i];
+    blob.length = range.length;
+    blob.data = (char *)malloc(range.length ? range.length : 1);
+    memcpy(blob.data, data + range.offset, range.length);
+  }
+  return true;
+}
+
+
+// Check whether text is all ASCII, eight bytes at a time.
+static bool
+IsAscii(const char *data, size_t length)
+{
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    if (LoadEightBytes(data + i) & 0x8080808080808080ULL)
+      return false;
+  }
+  for (; i < length; i++) {
+    if (data[i] & 0x80)
+      return false;
+  }
+  return true;
+}
+
+// Convert valid UTF-8, as LibYAML produces, to UTF-16. The output must have room for as many
+// code units as there are input bytes. Returns the number of code units.
+static size_t
+Utf8ToUtf16(const char *input, size_t length, uint16_t *output)
+{
+  const uint8_t *in = (const uint8_t *)input;
+  const uint8_t *end = in + length;
+  uint16_t *out = output;
+  while (in != end) {
+    uint32_t c = *in++;
+    if (c >= 0xF0) {
+      c = ((c & 0x07) << 18) | ((in[0] & 0x3F) << 12) | ((in[1] & 0x3F) << 6) | (in[2] & 0x3F);
+      in += 3;
+      c -= 0x10000;
+      *out++ = (uint16_t)(0xD800 + (c >> 10));
+      *out++ = (uint16_t)(0xDC00 + (c & 0x3FF));
+      continue;
+    }
+    if (c >= 0xE0) {
+      c = ((c & 0x0F) << 12) | ((in[0] & 0x3F) << 6) | (in[1] & 0x3F);
+      in += 2;
+    }
+    else if (c >= 0xC0) {
+      c = ((c & 0x1F) << 6) | (in[0] & 0x3F);
+      in += 1;
+    }
+    *out++ = (uint16_t)c;
+  }
+  return (size_t)(out - output);
+}
+
+// Resources for external strings, which own their heap block. V8 disposes of them once the
+// string is collected. The memory is reported to V8, so that it still counts towards collection.
+class ExternalAsciiString : public String::ExternalAsciiStringResource
+{
+public:
+  ExternalAsciiString(char *data, size_t length) : data_(data), length_(length)
+  {
+    V8::AdjustAmountOfExternalAllocatedMemory((intptr_t)length);
+  }
+
+  virtual
+  ~ExternalAsciiString()
+  {
+    free(data_);
+    V8::AdjustAmountOfExternalAllocatedMemory(-(intptr_t)length_);
+  }
+
+  virtual const char *data() const { return data_; }
+  virtual size_t length() const { return length_; }
+
+private:
+  char *data_;
+  size_t length_;
+};
+
+class ExternalTwoByteString : public String::ExternalStringResource
+{
+public:
+  ExternalTwoByteString(uint16_t *data, size_t length) : data_(data), length_(length)
+  {
+    V8::AdjustAmountOfExternalAllocatedMemory((intptr_t)(length * sizeof(uint16_t)));
+  }
+
+  virtual
+  ~ExternalTwoByteString()
+  {
+    free(data_);
+    V8::AdjustAmountOfExternalAllocatedMemory(-(intptr_t)(length_ * sizeof(uint16_t)));
+  }
+
+  virtual const uint16_t *data() const { return data_; }
+  virtual size_t length() const { return length_; }
+
+private:
+  uint16_t *data_;
+  size_t length_;
+};
+
+
+// Free a blob handed off to a Buffer.
+static void
+FreeBlob(char *data, void *hint)
+{
+  free(data);
+}
+
+// Wrap a SlowBuffer in a regular Buffer, which is what JavaScript code expects.
+static Local<Value>
+WrapBuffer(Buffer *slow, size_t length)
+{
+  Local<Function> constructor = Local<Function>::Cast(
+      Context::GetCurrent()->Global()->Get(buffer_symbol));
+  Local<Value> params[3] = {
+    Local<Value>::New(slow->handle_),
+    Integer::NewFromUnsigned((uint32_t)length),
+    Integer::New(0)
+  };
+  return constructor->NewInstance(3, params);
+}
+
+// Create a Buffer from a blob. If `take` is set, the Buffer takes over the blob without copying.
+static Local<Value>
+BlobToJs(Blob &blob, bool take)
+{
+  Buffer *slow;
+  if (take) {
+    slow = Buffer::New(blob.data, blob.length, FreeBlob, NULL);
+    blob.data = NULL;
+  }
+  else {
+    slow = Buffer::New(blob.data, blob.length);
+  }
+
+  return WrapBuffer(slow, blob.length);
+}
+
+// Create a string from a blob of UTF-8. If `take` is set, this hands off the blob to a new
+// external string. V8 only has external strings for ASCII and UTF-16, so other text is converted
+// to UTF-16 outside of the V8 heap.
+static Local<Value>
+ExternalStringToJs(Blob &blob, bool take)
+{
+  if (!take)
+    return String::New(blob.data, (int)blob.length);
+
+  char *data = blob.data;
+  size_t length = blob.length;
+  blob.data = NULL;
+
+  if (IsAscii(data, length))
+    return String::NewExternal(new ExternalAsciiString(data, length));
+
+  uint16_t *utf16 = (uint16_t *)malloc(length * sizeof(uint16_t));
+  size_t utf16_length = Utf8ToUtf16(data, length, utf16);
+  free(data);
+  return String::NewExternal(new ExternalTwoByteString(utf16, utf16_length));
+}
+
+// Create the value of a scalar record, given the string pool and blobs of its tape. If
+// `take_blobs` is set, blobs are handed off to the value, so this can only be done once per record.
+static Local<Value>
+RecordToJs(const char *strings, Blob *blobs, const Record &record, bool take_blobs)
+{
+  switch (record.type) {
+    case RECORD_NULL:      return Local<Value>::New(Null());
+    case RECORD_FALSE:     return Local<Value>::New(False());
+    case RECORD_TRUE:      return Local<Value>::New(True());
+    case RECORD_NUMBER:    return Number::New(record.data.number);
+    case RECORD_TIMESTAMP: return Date::New(record.data.number);
+    case RECORD_BINARY:
+      return BlobToJs(blobs[record.data.blob], take_blobs);
+    case RECORD_EXTERNAL_STRING:
+      return ExternalStringToJs(blobs[record.data.blob], take_blobs);
+    default:
+      return String::New(strings + record.data.string.offset, record.data.string.length);
+  }
+}
+
+static inline Local<Value>
+RecordToJs(Tape &tape, const Record &record, bool take_blobs)
+{
+  return RecordToJs(tape.strings.data(), tape.blobs.empty() ? NULL : &tape.blobs[0], record,
+      take_blobs);
+}
+
+
+// Builder options.
+enum {
+  // Build sequences of plain numbers as `Float64Array` or `Int32Array`.
+  BUILD_TYPED_ARRAYS = 1 << 0,
+
+  // Build sequences of mappings with the same keys as an object of columns.
+  BUILD_COLUMNAR     = 1 << 1,
+
+  // Build mappings with at least a threshold number of pairs as `Map` instances.
+  BUILD_MAPS         = 1 << 2,
+
+  // Share frozen values between identical subtrees.
+  BUILD_DEDUPE       = 1 << 3
+};
+
+// Builds JavaScript values from a tape.
+//
+// Because the tape has the number of children of each collection, arrays are created with their
+// final length right away, rather than grown one element at a time. Scalars are already
+// resolved on the tape, so only nodes with a user tag handler call back into JavaScript.
+class Builder
+{
+public:
+  // Results of a build step.
+  enum {
+    STEP_DONE,
+    STEP_PAUSED,
+    STEP_WAITING,
+    STEP_FAILED
+  };
+
+  Builder(Tape &tape, Handle<Object> tag_handlers, int flags, uint32_t map_threshold)
+    : tape_(tape), tag_handlers_(tag_handlers), flags_(flags), map_threshold_(map_threshold),
+      handlers_(tape.tags.size() + 1), documents_(Array::New()), num_documents_(0), next_(0),
+      hashed_(false) {}
+
+  // Build from the records added to the tape since the last step. Until `complete`, more
+  // records may follow, and collections that are built as a whole wait until they are closed.
+  // With a `deadline` in `uv_hrtime` units, stops once it has passed. Returns `STEP_DONE` when
+  // all documents are built, `STEP_PAUSED` at the deadline, `STEP_WAITING` when it needs more
+  // records, and `STEP_FAILED` if an exception was thrown.
+  int
+  Step(bool complete, uint64_t deadline)
+  {
+    if (handlers_.size() < tape_.tags.size() + 1)
+      handlers_.resize(tape_.tags.size() + 1);
+
+    // Deduplication compares whole subtrees, and keeps handles that can't be suspended.
+    if (flags_ & BUILD_DEDUPE) {
+      if (!complete)
+        return STEP_WAITING;
+      if (!hashed_) {
+        HashSubtrees();
+        hashed_ = true;
+      }
+      deadline = 0;
+    }
+
+    std::vector<Frame> &stack = stack_;
+    std::vector<Record> &records = tape_.records;
+    size_t size = records.size();
+    for (size_t i = next_; i < size; i++) {
+      if (deadline != 0 && i != next_ && i % STEP_CHECK_INTERVAL == 0 && uv_hrtime() >= deadline) {
+        next_ = i;
+        return STEP_PAUSED;
+      }
+
+      Record &record = records[i];
+      Local<Value> value;
+
+      // Whether the value may be shared by identical subtrees.
+      bool shareable = false;
+
+      switch (record.type) {
+        case RECORD_SEQUENCE:
+        case RECORD_MAPPING: {
+          if (flags_ & BUILD_DEDUPE) {
+            value = FindSubtree(i);
+            if (!value.IsEmpty()) {
+              shareable = true;
+              i = record.data.collection.end;
+              break;
+            }
+          }
+
+          // Collections that are not closed yet have only part of their records on the tape.
+          if (record.data.collection.end == 0 && NeedsWhole(record)) {
+            next_ = i;
+            return STEP_WAITING;
+          }
+
+          if (record.type == RECORD_SEQUENCE) {
+            Local<Object> special;
+            if ((flags_ & BUILD_COLUMNAR) && IsUniform(i)) {
+              special = Columns(i);
+              if (special.IsEmpty())
+                return STEP_FAILED;
+            }
+            else if (flags_ & BUILD_TYPED_ARRAYS) {
+              special = NumericSequence(i);
+            }
+            if (!special.IsEmpty()) {
+              value = Complete(record, (uint32_t)i, special);
+              if (value.IsEmpty())
+                return STEP_FAILED;
+              i = record.data.collection.end;
+              break;
+            }
+          }
+          // Otherwise, build a regular array or object.
+        }
+
+        case RECORD_DOCUMENT: {
+          Frame frame;
+          frame.start = (uint32_t)i;
+          frame.index = 0;
+          frame.shape = NULL;
+          frame.key = 0;
+          frame.map = false;
+          frame.shareable = true;
+          if (record.type == RECORD_SEQUENCE) {
+            frame.object = Array::New(record.data.collection.count);
+          }
+          else if (record.type == RECORD_MAPPING && (flags_ & BUILD_MAPS)
+              && record.data.collection.count >= map_threshold_) {
+            frame.object = NewMap();
+            if (frame.object.IsEmpty())
+              return STEP_FAILED;
+            frame.map = true;
+          }
+          else if (record.type == RECORD_MAPPING) {
+            // Shapes need all keys of the mapping.
+            frame.shape = record.data.collection.end != 0 ? FindShape(i) : NULL;
+            frame.object = frame.shape ? frame.shape->boilerplate->Clone() : Object::New();
+          }
+          if (record.flags & RECORD_ANCHORED)
+            anchors_[(uint32_t)i] = frame.object;
+          stack.push_back(frame);
+          continue;
+        }
+
+        case RECORD_END: {
+          Frame frame = stack.back();
+          stack.pop_back();
+          Record &start = records[frame.start];
+          if (start.type == RECORD_DOCUMENT) {
+            documents_->Set(num_documents_++, frame.value);
+            continue;
+          }
+          value = Complete(start, frame.start, frame.object);
+          if (value.IsEmpty())
+            return STEP_FAILED;
+          if ((flags_ & BUILD_DEDUPE) && frame.shareable && !frame.map && IsPlain(start)) {
+            if (!ShareSubtree(frame.start, value))
+              return STEP_FAILED;
+            shareable = true;
+          }
+          break;
+        }
+
+        case RECORD_ALIAS:
+          value = anchors_[record.data.target];
+          break;
+
+        default:
+          // Keys of a mapping with a shape are already on hand.
+          if (stack.back().shape != NULL && stack.back().index == 0) {
+            Frame &parent = stack.back();
+            value = parent.shape->keys[parent.key++];
+            shareable = true;
+            break;
+          }
+          value = Complete(record, (uint32_t)i, ScalarToJs(record));
+          if (value.IsEmpty())
+            return STEP_FAILED;
+          // Dates and Buffers can be modified, even when frozen.
+          shareable = record.type != RECORD_TIMESTAMP && record.type != RECORD_BINARY
+              && IsPlain(record);
+          break;
+      }
+
+  // Add the value to its parent.
+      Frame &parent = stack.back();
+      if (!shareable)
+        parent.shareable = false;
+      switch (records[parent.start].type) {
+        case RECORD_DOCUMENT:
+          parent.value = value;
+          break;
+        case RECORD_SEQUENCE:
+          parent.object->Set(parent.index++, value);
+          break;
+        case RECORD_MAPPING:
+          if (parent.index == 0) {
+            parent.value = value;
+            parent.index = 1;
+          }
+          else if (parent.map) {
+            Local<Value> params[2] = { parent.value, value };
+            if (map_set_->Call(parent.object, 2, params).IsEmpty())
+              return STEP_FAILED;
+            parent.index = 0;
+          }
+          else {
+            parent.object->Set(parent.value, value);
+            parent.index = 0;
+          }
+          break;
+      }
+    }
+
+    next_ = size;
+    return complete ? STEP_DONE : STEP_WAITING;
+  }
+
+  // The array of documents built so far.
+  Local<Array>
+  Documents()
+  {
+    return documents_;
+  }
+
+  // Keep the values of a paused build in `holder`, so that it can continue from another call
+  // into V8. Cached handles are dropped, and mappings being filled continue without a shape.
+  void
+  Suspend(Handle<Array> holder)
+  {
+    Local<Array> anchors = Array::New();
+    uint32_t k = 0;
+    std::map<uint32_t, Local<Value> >::iterator it;
+    for (it = anchors_.begin(); it != anchors_.end(); ++it) {
+      anchors->Set(k++, Integer::NewFromUnsigned(it->first));
+      anchors->Set(k++, it->second);
+    }
+    holder->Set(0, documents_);
+    holder->Set(1, anchors);
+
+    for (size_t i = 0; i < stack_.size(); i++) {
+      Frame &frame = stack_[i];
+      holder->Set((uint32_t)(2 + 2 * i), frame.object.IsEmpty()
+          ? Local<Value>::New(Undefined()) : Local<Value>(frame.object));
+      holder->Set((uint32_t)(3 + 2 * i), frame.value.IsEmpty()
+          ? Local<Value>::New(Undefined()) : frame.value);
+      frame.shape = NULL;
+    }
+
+    anchors_.clear();
+    shapes_.clear();
+    handlers_.assign(handlers_.size(), Local<Value>());
+    int32_array_.Clear();
+    float64_array_.Clear();
+    map_constructor_.Clear();
+    map_set_.Clear();
+  }
+
+  // Continue a build kept with `Suspend`.
+  void
+  Resume(Handle<Object> tag_handlers, Handle<Array> holder)
+  {
+    tag_handlers_ = tag_handlers;
+    documents_ = Local<Array>::Cast(holder->Get(0));
+
+    Local<Array> anchors = Local<Array>::Cast(holder->Get(1));
+    for (uint32_t k = 0; k < anchors->Length(); k += 2)
+      anchors_[anchors->Get(k)->Uint32Value()] = anchors->Get(k + 1);
+
+    bool maps = false;
+    for (size_t i = 0; i < stack_.size(); i++) {
+      Frame &frame = stack_[i];
+      Local<Value> object = holder->Get((uint32_t)(2 + 2 * i));
+      if (object->IsObject())
+        frame.object = Local<Object>::Cast(object);
+      frame.value = holder->Get((uint32_t)(3 + 2 * i));
+      if (frame.map)
+        maps = true;
+    }
+    if (maps)
+      FindMap();
+  }
+
+private:
+  // Limits to the shape cache.
+  enum {
+    MAX_SHAPE_KEYS = 64,
+    MAX_SHAPES     = 1024
+  };
+
+  // How many records to build between checks of the deadline.
+  static const size_t STEP_CHECK_INTERVAL = 256;
+
+  // The keys of a kind of mapping, and an object with those keys to clone new mappings from.
+  // Mappings cloned from the same boilerplate share a hidden class, and have all of their
+  // properties from the start.
+  struct Shape {
+    Local<Object> boilerplate;
+    std::vector<Local<String> > keys;
+  };
+
+  // An open document or collection.
+  struct Frame {
+    // Index of the start record.
+    uint32_t start;
+
+    // The array or object being filled. Unused for documents.
+    Local<Object> object;
+
+    // For documents, the root node. For mappings, the pending key.
+    Local<Value> value;
+
+    // For sequences, the next index. For mappings, whether a key is pending.
+    uint32_t index;
+
+    // For mappings, the shape, if any, and the index of the next key in it.
+    Shape *shape;
+    uint32_t key;
+
+    // For mappings, whether the object is a `Map`.
+    bool map;
+
+    // Whether all children so far may be shared by identical subtrees.
+    bool shareable;
+  };
+
+  // An earlier subtree, that is shared by later identical ones.
+  struct Subtree {
+    uint32_t start;
+    Local<Value> value;
+  };
+
+  // Hash all collections on the tape, bottom-up. Hashes are over the records, without their
+  // marks, so that identical subtrees have the same hash.
+  void
+  HashSubtrees()
+  {
+    std::vector<Record> &records = tape_.records;
+    hashes_.assign(records.size(), 0);
+    std::vector<uint32_t> open;
+    for (size_t i = 0; i < records.size(); i++) {
+      Record &record = records[i];
+      uint64_t hash;
+      switch (record.type) {
+        case RECORD_DOCUMENT:
+        case RECORD_SEQUENCE:
+        case RECORD_MAPPING:
+          hashes_[i] = HashCombine(HashCombine(record.type, record.tag), record.flags);
+          open.push_back((uint32_t)i);
+          continue;
+
+        case RECORD_END: {
+          uint32_t start = open.back();
+          open.pop_back();
+          hash = HashCombine(hashes_[start], records[start].data.collection.count);
+          hashes_[start] = hash;
+          break;
+        }
+
+        default:
+          hash = HashCombine(HashCombine(record.type, record.tag), record.flags);
+          switch (record.type) {
+            case RECORD_NUMBER:
+            case RECORD_TIMESTAMP: {
+              uint64_t bits;
+              memcpy(&bits, &record.data.number, sizeof(bits));
+              hash = HashCombine(hash, bits);
+              break;
+            }
+            case RECORD_STRING: {
+              // FNV-1a.
+              const char *data = tape_.strings.data() + record.data.string.offset;
+              uint64_t string_hash = 14695981039346656037ULL;
+              for (uint32_t k = 0; k < record.data.string.length; k++) {
+                string_hash ^= (uint8_t)data[k];
+                string_hash *= 1099511628211ULL;
+              }
+              hash = HashCombine(hash, string_hash);
+              break;
+            }
+            case RECORD_ALIAS:
+              hash = HashCombine(hash, record.data.target);
+              break;
+            case RECORD_BINARY:
+            case RECORD_EXTERNAL_STRING:
+              hash = HashCombine(hash, record.data.blob);
+              break;
+          }
+          break;
+      }
+      if (!open.empty())
+        hashes_[open.back()] = HashCombine(hashes_[open.back()], hash);
+    }
+  }
+
+  static uint64_t
+  HashCombine(uint64_t hash, uint64_t value)
+  {
+    return hash ^ (value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2));
+  }
+
+  // Find an earlier subtree identical to the one starting at `index`. Returns an empty handle if
+  // there is none.
+  Local<Value>
+  FindSubtree(size_t index)
+  {
+    typedef std::multimap<uint64_t, Subtree>::iterator Iterator;
+    std::pair<Iterator, Iterator> range = subtrees_.equal_range(hashes_[index]);
+    for (Iterator it = range.first; it != range.second; ++it) {
+      if (SameSubtree(it->second.start, (uint32_t)index))
+        return it->second.value;
+    }
+    return Local<Value>();
+  }
+
+  // Freeze a completed subtree, and remember it for later identical ones. Its children are
+  // already frozen. Returns false if freezing threw.
+  bool
+  ShareSubtree(uint32_t start, Local<Value> value)
+  {
+    if (freeze_.IsEmpty()) {
+      Local<Object> object = Local<Object>::Cast(
+          Context::GetCurrent()->Global()->Get(object_symbol));
+      freeze_ = Local<Function>::Cast(object->Get(freeze_symbol));
+    }
+    Local<Value> params[1] = { value };
+    if (freeze_->Call(Context::GetCurrent()->Global(), 1, params).IsEmpty())
+      return false;
+
+    Subtree subtree;
+    subtree.start = start;
+    subtree.value = value;
+    subtrees_.insert(std::make_pair(hashes_[start], subtree));
+    return true;
+  }
+
+  // Compare the records of two subtrees, ignoring their marks.
+  bool
+  SameSubtree(uint32_t a, uint32_t b)
+  {
+    std::vector<Record> &records = tape_.records;
+    uint32_t length = records[a].data.collection.end - a;
+    if (records[b].data.collection.end - b != length)
+      return false;
+
+    for (uint32_t k = 0; k <= length; k++) {
+      Record &x = records[a + k];
+      Record &y = records[b + k];
+      if (x.type != y.type || x.flags != y.flags || x.tag != y.tag)
+        return false;
+      switch (x.type) {
+        case RECORD_SEQUENCE:
+        case RECORD_MAPPING:
+          if (x.data.collection.count != y.data.collection.count
+              || x.data.collection.end - (a + k) != y.data.collection.end - (b + k))
+            return false;
+          break;
+        case RECORD_NUMBER:
+        case RECORD_TIMESTAMP:
+          if (memcmp(&x.data.number, &y.data.number, sizeof(double)) != 0)
+            return false;
+          break;
+        case RECORD_STRING:
+          if (!SameString(x, y))
+            return false;
+          break;
+        case RECORD_ALIAS:
+          if (x.data.target != y.data.target)
+            return false;
+          break;
+        case RECORD_BINARY:
+        case RECORD_EXTERNAL_STRING:
+          if (x.data.blob != y.data.blob)
+            return false;
+          break;
+      }
+    }
+    return true;
+  }
+
+  // Check whether a collection must be built from all of its records at once.
+  bool
+  NeedsWhole(Record &record)
+  {
+    if (record.type == RECORD_SEQUENCE)
+      return (flags_ & (BUILD_COLUMNAR | BUILD_TYPED_ARRAYS)) != 0;
+    return (flags_ & BUILD_MAPS) && map_threshold_ > 0;
+  }
+
+  // Look up `Map` and its `set` method. Returns false if this V8 has no `Map`.
+  bool
+  FindMap()
+  {
+    Local<Value> constructor = Context::GetCurrent()->Global()->Get(map_symbol);
+    if (!constructor->IsFunction())
+      return false;
+    map_constructor_ = Local<Function>::Cast(constructor);
+    Local<Value> prototype = map_constructor_->Get(prototype_symbol);
+    map_set_ = Local<Function>::Cast(Local<Object>::Cast(prototype)->Get(set_symbol));
+    return true;
+  }
+
+  // Create an empty `Map`. Throws and returns an empty handle if this V8 has no `Map`.
+  Local<Object>
+  NewMap()
+  {
+    if (map_constructor_.IsEmpty() && !FindMap()) {
+      ThrowException(Exception::Error(
+          String::New("Maps are not supported by this version of V8.")));
+      return Local<Object>();
+    }
+    return map_constructor_->NewInstance();
+  }
+
+  // Find or create the shape of a mapping. Returns NULL if the mapping has keys other than plain
+  // strings, or too many to be worth it.
+  Shape *
+  FindShape(size_t index)
+  {
+    std::vector<Record> &records = tape_.records;
+    uint32_t count = records[index].data.collection.count;
+    if (count == 0 || count > MAX_SHAPE_KEYS)
+      return NULL;
+
+    // Shapes are identified by their keys, each prefixed with its length.
+    shape_id_.clear();
+    shape_keys_.clear();
+    size_t j = index + 1;
+    for (uint32_t k = 0; k < count; k++) {
+      Record &key = records[j];
+      if (key.type != RECORD_STRING || !IsPlain(key))
+        return NULL;
+      const char *data = tape_.strings.data() + key.data.string.offset;
+      uint32_t length = key.data.string.length;
+      if (length == 9 && memcmp(data, "__proto__", 9) == 0)
+        return NULL;
+      shape_id_.append((const char *)&length, sizeof(length));
+      shape_id_.append(data, length);
+      shape_keys_.push_back(&key);
+
+      Record &value = records[j + 1];
+      if (value.type == RECORD_SEQUENCE || value.type == RECORD_MAPPING)
+        j = value.data.collection.end + 1;
+      else
+        j += 2;
+    }
+
+    std::map<std::string, Shape>::iterator it = shapes_.find(shape_id_);
+    if (it != shapes_.end())
+      return &it->second;
+    if (shapes_.size() >= MAX_SHAPES)
+      return NULL;
+
+    Shape &shape = shapes_[shape_id_];
+    shape.boilerplate = Object::New();
+    for (uint32_t k = 0; k < count; k++) {
+      Record &key = *shape_keys_[k];
+      Local<String> name = String::NewSymbol(tape_.strings.data() + key.data.string.offset,
+          key.data.string.length);
+      shape.boilerplate->Set(name, Undefined());
+      shape.keys.push_back(name);
+    }
+    return &shape;
+  }
+
+  Local<Value>
+  ScalarToJs(Record &record)
+  {
+    return RecordToJs(tape_, record, true);
+  }
+
+  // Look up the tag handler for a record. Handlers are looked up only once per tag. Results in
+  // undefined if there is none.
+  Local<Value>
+  Handler(Record &record)
+  {
+    if (record.tag == 0)
+      return Local<Value>::New(Undefined());
+
+    Local<Value> &handler = handlers_[record.tag];
+    if (handler.IsEmpty()) {
+      handler = tag_handlers_->Get(String::New(tape_.tags[record.tag - 1].c_str()));
+      if (!handler->IsFunction())
+        handler = Local<Value>::New(Undefined());
+    }
+    return handler;
+  }
+
+  // Post-process the value of a node using its tag handler, if any, and remember the result if
+  // the node has an anchor. Returns an empty handle if the handler threw.
+  Local<Value>
+  Complete(Record &record, uint32_t index, Local<Value> value)
+  {
+    Local<Value> handler = Handler(record);
+    if (handler->IsFunction()) {
+      Local<Value> params[1] = { value };
+      value = Local<Function>::Cast(handler)->Call(Context::GetCurrent()->Global(), 1, params);
+      if (value.IsEmpty())
+        return value;
+    }
+    if (record.flags & RECORD_ANCHORED)
+      anchors_[index] = value;
+    return value;
+  }
+
+  // Build a typed array for a sequence of plain numbers. Returns an empty handle if the sequence
+  // is empty, or has other children.
+  Local<Object>
+  NumericSequence(size_t index)
+  {
+    Record &record = tape_.records[index];
+    uint32_t count = record.data.collection.count;
+    if (count == 0 || record.data.collection.end != index + count + 1)
+      return Local<Object>();
+    return NumericArray(index + 1, 1, count);
+  }
+
+  // Build a typed array from the numbers at `first`, `first + stride`, and so on. This is an
+  // `Int32Array` if all of them fit, otherwise a `Float64Array`. Returns an empty handle if any
+  // of the records is not a plain number, ie. one that is anchored or has a tag handler.
+  Local<Object>
+  NumericArray(size_t first, size_t stride, uint32_t length)
+  {
+    std::vector<Record> &records = tape_.records;
+    bool integers = true;
+    for (size_t i = 0, j = first; i < length; i++, j += stride) {
+      Record &record = records[j];
+      if (record.type != RECORD_NUMBER || !IsPlain(record))
+        return Local<Object>();
+      double number = record.data.number;
+      if (integers && !IsInt32(number))
+        integers = false;
+    }
+
+    Local<Value> &constructor = integers ? int32_array_ : float64_array_;
+    if (constructor.IsEmpty())
+      constructor = Context::GetCurrent()->Global()->Get(
+          integers ? int32_array_symbol : float64_array_symbol);
+    if (!constructor->IsFunction())
+      return Local<Object>();
+
+    Local<Value> params[1] = { Integer::NewFromUnsigned(length) };
+    Local<Object> array = Local<Function>::Cast(constructor)->NewInstance(1, params);
+    if (array.IsEmpty() || !array->HasIndexedPropertiesInExternalArrayData())
+      return Local<Object>();
+
+    // Fill the backing store directly.
+    void *data = array->GetIndexedPropertiesExternalArrayData();
+    for (size_t i = 0, j = first; i < length; i++, j += stride) {
+      if (integers)
+        ((int32_t *)data)[i] = (int32_t)records[j].data.number;
+      else
+        ((double *)data)[i] = records[j].data.number;
+    }
+    return array;
+  }
+
+  // Check whether a sequence consists of mappings with the same keys, in the same order, and
+  // only scalar values. Keys must be distinct plain strings, and mappings must be plain too.
+  bool
+  IsUniform(size_t index)
+  {
+    std::vector<Record> &records = tape_.records;
+    Record &record = records[index];
+    uint32_t count = record.data.collection.count;
+    if (count == 0 || records[index + 1].type != RECORD_MAPPING)
+      return false;
+    uint32_t num_keys = records[index + 1].data.collection.count;
+    size_t stride = 2 * (size_t)num_keys + 2;
+    if (num_keys == 0 || record.data.collection.end != index + 1 + count * stride)
+      return false;
+
+    std::set<std::string> keys;
+    for (size_t j = index + 1; j < record.data.collection.end; j += stride) {
+      Record &mapping = records[j];
+      if (mapping.type != RECORD_MAPPING || mapping.data.collection.end != j + stride - 1
+          || !IsPlain(mapping))
+        return false;
+
+      for (uint32_t k = 0; k < num_keys; k++) {
+        Record &key = records[j + 1 + 2 * k];
+        Record &value = records[j + 2 + 2 * k];
+        if (key.type != RECORD_STRING || !IsPlain(key) || value.type < RECORD_NULL)
+          return false;
+        if (j == index + 1) {
+          if (!keys.insert(RecordString(key)).second)
+            return false;
+        }
+        else if (!SameString(key, records[index + 2 + 2 * k])) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Build the columns of a uniform sequence. Numeric columns become typed arrays, other columns
+  // regular arrays. Returns an empty handle if a tag handler threw.
+  Local<Object>
+  Columns(size_t index)
+  {
+    std::vector<Record> &records = tape_.records;
+    uint32_t count = records[index].data.collection.count;
+    uint32_t num_keys = records[index + 1].data.collection.count;
+    size_t stride = 2 * (size_t)num_keys + 2;
+
+    Local<Object> columns = Object::New();
+    for (uint32_t k = 0; k < num_keys; k++) {
+      size_t first = index + 3 + 2 * k;
+      Local<Object> column = NumericArray(first, stride, count);
+      if (column.IsEmpty()) {
+        Local<Array> array = Array::New(count);
+        for (size_t i = 0, j = first; i < count; i++, j += stride) {
+          Local<Value> value = Complete(records[j], (uint32_t)j, ScalarToJs(records[j]));
+          if (value.IsEmpty())
+            return Local<Object>();
+          array->Set((uint32_t)i, value);
+        }
+        column = array;
+      }
+      columns->Set(ScalarToJs(records[first - 1]), column);
+    }
+    return columns;
+  }
+
+  // Check whether a node is used as is, ie. has no anchor and no tag handler.
+  bool
+  IsPlain(Record &record)
+  {
+    return !(record.flags & RECORD_ANCHORED) && !Handler(record)->IsFunction();
+  }
+
+  std::string
+  RecordString(Record &record)
+  {
+    return tape_.strings.substr(record.data.string.offset, record.data.string.length);
+  }
+
+  bool
+  SameString(Record &a, Record &b)
+  {
+    return a.data.string.length == b.data.string.length
+        && memcmp(tape_.strings.data() + a.data.string.offset,
+                  tape_.strings.data() + b.data.string.offset, a.data.string.length) == 0;
+  }
+
+  static bool
+  IsInt32(double number)
+  {
+    if (!(number >= -2147483648.0 && number <= 2147483647.0) || (int32_t)number != number)
+      return false;
+    // Negative zero doesn't survive either.
+    return number != 0 || 1 / number > 0;
+  }
+
+  Tape &tape_;
+  Handle<Object> tag_handlers_;
+  int flags_;
+  uint32_t map_threshold_;
+  std::vector<Local<Value> > handlers_;
+  Local<Value> int32_array_;
+  Local<Value> float64_array_;
+  Local<Function> map_constructor_;
+  Local<Function> map_set_;
+  std::vector<uint64_t> hashes_;
+  std::multimap<uint64_t, Subtree> subtrees_;
+  Local<Function> freeze_;
+  std::map<std::string, Shape> shapes_;
+  std::string shape_id_;
+  std::vector<Record *> shape_keys_;
+  std::map<uint32_t, Local<Value> > anchors_;
+  Local<Array> documents_;
+  uint32_t num_documents_;
+  std::vector<Frame> stack_;
+  size_t next_;
+  bool hashed_;
+};
+
+
+// Parse a string into a tape. Returns false if an exception was thrown.
+static bool
+ParseStringToTape(Handle<Value> input, Tape &tape, bool unique_keys)
+{
+  String::Value value(input);
+  yaml_parser_t parser;
+  if (!InitializeParser(parser, value)) {
+    ThrowException(Exception::Error(
+        String::New("Could not initiaize libYAML")));
+    return false;
+  }
+
+  int ok = ParseToTape(parser, tape, unique_keys);
+  if (!ok)
+    ThrowException(ParserErrorToJs(parser));
+  yaml_parser_delete(&parser);
+  return ok != 0;
+}
+
+// Create the error for a parse stopped early. Aborted parses have the code `ABORT_ERR`, and
+// those past their deadline `ETIMEDOUT`.
+static Local<Value>
+CancelToJs(int reason)
+{
+  bool aborted = reason == CANCEL_ABORTED;
+  Local<Object> error = Local<Object>::Cast(Exception::Error(String::New(aborted
+      ? "Parsing was aborted." : "Parsing did not finish before its deadline.")));
+  error->Set(code_symbol, String::New(aborted ? "ABORT_ERR" : "ETIMEDOUT"));
+  return error;
+}
+
+// Read the options of `loadAsync` and friends that stop parsing early: an `abortFlag` Buffer,
+// which is kept alive in `buffer`, and a number of milliseconds in `timeoutMs`.
+static void
+GetCancelOptions(Local<Object> options, Cancel &cancel, Persistent<Object> &buffer)
+{
+  Local<Value> flag = options->Get(abort_flag_symbol);
+  const uint8_t *data;
+  size_t length;
+  if (GetByteArrayData(flag, data, length) && length != 0) {
+    buffer = Persistent<Object>::New(Local<Object>::Cast(flag));
+    cancel.flag = data;
+  }
+
+  Local<Value> timeout = options->Get(timeout_symbol);
+  if (timeout->IsNumber()) {
+    double ms = timeout->NumberValue();
+    cancel.deadline = uv_hrtime() + (uint64_t)((ms > 0 ? ms : 0) * 1e6);
+  }
+}
+
+// Read the options of `load` that control how documents are built.
+static void
+GetBuildOptions(Local<Object> options, Local<Object> &tag_handlers, int &flags,
+    uint32_t &map_threshold)
+{
+  Local<Value> value = options->Get(tag_handlers_symbol);
+  tag_handlers = value->IsObject() ? Local<Object>::Cast(value) : Object::New();
+  flags = 0;
+  if (options->Get(typed_arrays_symbol)->BooleanValue())
+    flags |= BUILD_TYPED_ARRAYS;
+  if (options->Get(columnar_symbol)->BooleanValue())
+    flags |= BUILD_COLUMNAR;
+  if (options->Get(dedupe_symbol)->BooleanValue())
+    flags |= BUILD_DEDUPE;
+  map_threshold = 0;
+  Local<Value> maps = options->Get(maps_symbol);
+  if (maps->IsNumber()) {
+    flags |= BUILD_MAPS;
+    map_threshold = maps->Uint32Value();
+  }
+}
+
+// Build the documents on a tape, according to the options of `load`. Returns an empty handle if
+// an exception was thrown. With a `deadline` in `uv_hrtime` units, throws once it has passed.
+static Local<Array>
+BuildDocuments(Tape &tape, Local<Object> options, uint64_t deadline = 0)
+{
+  Local<Object> tag_handlers;
+  int flags;
+  uint32_t map_threshold;
+  GetBuildOptions(options, tag_handlers, flags, map_threshold);
+
+  Builder builder(tape, tag_handlers, flags, map_threshold);
+  switch (builder.Step(true, deadline)) {
+    case Builder::STEP_DONE:
+      return builder.Documents();
+    case Builder::STEP_PAUSED:
+      ThrowException(CancelToJs(CANCEL_TIMED_OUT));
+      return Local<Array>();
+    default:
+      return Local<Array>();
+  }
+}
+
+
+// Binding to the native document builder. The function signature is:
+//
+//     load(input, options);
+//
+// Where `input` is a string. `options` may contain a `tagHandlers` object, which maps tags to
+// functions that post-process values of nodes with that tag. The `typedArrays` flag builds
+// sequences of plain numbers as typed arrays, and the `columnar` flag builds sequences of
+// mappings with the same keys as an object of columns. If `maps` is a number, mappings with at
+// least that many pairs are built as `Map` instances. The `uniqueKeys` flag makes duplicate keys
+// in a mapping an error, and the `dedupe` flag shares frozen values between identical subtrees.
+// The return value is an array of documents.
+//
+// Scalars are resolved natively, as YAML 1.1 types, or according to their standard tag, eg.
+// `!!str` or `!!int`. A scalar that doesn't match its standard tag is an error. `!!binary`
+// scalars are decoded to Buffers.
+static Handle<Value>
+Load(const Arguments &args)
+{
+  HandleScope scope;
+
+  // Check arguments.
+  if (args.Length() != 2)
+    return ThrowException(Exception::Error(
+        String::New("Two arguments were expected.")));
+  if (!args[0]->IsString())
+    return ThrowException(Exception::TypeError(
+        String::New("Input must be a string.")));
+  if (!args[1]->IsObject())
+    return ThrowException(Exception::TypeError(
+        String::New("Options must be an object.")));
+
+  // Parse the input into a tape, and build the documents.
+  Local<Object> options = Local<Object>::Cast(args[1]);
+  Tape tape;
+  if (!ParseStringToTape(args[0], tape, options->Get(unique_keys_symbol)->BooleanValue()))
+    return Undefined();
+  Local<Array> documents = BuildDocuments(tape, options);
+  if (documents.IsEmpty())
+    return Undefined();
+  return scope.Close(documents);
+}
+
+
+// Compile a string for `loadCompiled`:
+//
+//     var compiled = binding.compile(input, options);
+//
+// Where `input` is a string. The only option is `uniqueKeys`, as with `load`. The return value
+// is a Buffer with the parsed and resolved input, in a form that is only valid for this build of
+// the binding on this machine.
+static Handle<Value>
+Compile(const Arguments &args)
+{
+  HandleScope scope;
+
+  // Check arguments.
+  if (args.Length() != 2)
+    return ThrowException(Exception::Error(
+        String::New("Two arguments were expected.")));
+  if (!args[0]->IsString())
+    return ThrowException(Exception::TypeError(
+        String::New("Input must be a string.")));
+  if (!args[1]->IsObject())
+    return ThrowException(Exception::TypeError(
+        String::New("Options must be an object.")));
+
+  Local<Object> options = Local<Object>::Cast(args[1]);
+  Tape tape;
+  if (!ParseStringToTape(args[0], tape, options->Get(unique_keys_symbol)->BooleanValue()))
+    return Undefined();
+
+  std::string compiled;
+  CompileTape(tape, compiled);
+  Buffer *slow = Buffer::New(compiled.data(), compiled.size());
+  return scope.Close(WrapBuffer(slow, compiled.size()));
+}
+
+// Load all documents from the output of `compile`:
+//
+//     var documents = binding.loadCompiled(compiled, options);
+//
+// Where `compiled` is a Buffer, and `options` are the same as for `load`, except `uniqueKeys`,
+// which is applied by `compile`. Returns null if the Buffer is not a valid compiled stream for this
+// build, so that callers can compile the input again.
+static Handle<Value>
+LoadCompiled(const Arguments &args)
+{
+  HandleScope scope;
+
+  // Check arguments.
+  if (args.Length() != 2)
+    return ThrowException(Exception::Error(
+        String::New("Two arguments were expected.")));
+  const uint8_t *data;
+  size_t length;
+  if (!GetByteArrayData(args[0], data, length))
+    return ThrowException(Exception::TypeError(
+        String::New("Input must be a Buffer.")));
+  if (!args[1]->IsObject())
+    return ThrowException(Exception::TypeError(
+        String::New("Options must be an object.")));
+
+  Tape tape;
+  if (!LoadCompiledTape((const char *)data, length, tape))
+    return Null();
+  Local<Array> documents = BuildDocuments(tape, Local<Object>::Cast(args[1]));
+  if (documents.IsEmpty())
+    return Undefined();
+  return scope.Close(documents);
+}
+
+// A `loadAsync` call in progress. The parser runs on the thread pool, which is safe because
+// parsing into a tape does not touch V8, and everything it shares is read-only once the binding
+// is initialized.
+struct LoadRequest {
+  uv_work_t work;
+  String::Value input;
+  yaml_parser_t parser;
+  bool unique_keys;
+  int ok;
+  Tape tape;
+  Cancel cancel;
+  Persistent<Object> abort_flag;
+  Persistent<Object> options;
+  Persistent<Function> callback;
+
+  LoadRequest(Handle<Value> value) : input(value), ok(0) {}
+};
+
+static void
+LoadWork(uv_work_t *work)
+{
+  LoadRequest *request = (LoadRequest *)work->data;
+  request->ok = ParseToTape(request->parser, request->tape, request->unique_keys,
+      &request->cancel);
+}
+
+// Build the documents on the main thread, and call back.
+#if NODE_VERSION_AT_LEAST(0, 9, 4)
+static void
+LoadDone(uv_work_t *work, int status)
+#else
+static void
+LoadDone(uv_work_t *work)
+#endif
+{
+  HandleScope scope;
+  LoadRequest *request = (LoadRequest *)work->data;
+
+  Local<Value> params[2] = { Local<Value>::New(Null()), Local<Value>::New(Null()) };
+  if (request->cancel.Check()) {
+    params[0] = CancelToJs(request->cancel.reason);
+  }
+  else if (!request->ok) {
+    params[0] = ParserErrorToJs(request->parser);
+  }
+  else {
+    TryCatch try_catch;
+    Local<Array> documents = BuildDocuments(request->tape, Local<Object>::New(request->options),
+        request->cancel.deadline);
+    if (documents.IsEmpty())
+      params[0] = try_catch.Exception();
+    else
+      params[1] = documents;
+  }
+
+  Local<Function> callback = Local<Function>::New(request->callback);
+  yaml_parser_delete(&request->parser);
+  request->abort_flag.Dispose();
+  request->options.Dispose();
+  request->callback.Dispose();
+  delete request;
+
+  TryCatch try_catch;
+  callback->Call(Context::GetCurrent()->Global(), 2, params);
+  if (try_catch.HasCaught())
+    FatalException(try_catch);
+}
+
+// Asynchronous version of `load`:
+//
+//     binding.loadAsync(input, options, function(error, documents) { /* ... */ });
+//
+// The input is parsed into a tape on the thread pool, so several inputs can be parsed at once,
+// and only the documents are built on the main thread. Errors, including those thrown by tag
+// handlers, are passed to the callback.
+//
+// Parsing stops early once the first byte of the `options.abortFlag` Buffer is set, or after
+// `options.timeoutMs` milliseconds, checked every `CANCEL_CHECK_EVENTS` events. The deadline
+// also bounds building, except with `dedupe`.
+static Handle<Value>
+LoadAsync(const Arguments &args)
+{
+  HandleScope scope;
+
+  // Check arguments.
+  if (args.Length() != 3)
+    return ThrowException(Exception::Error(
+        String::New("Three arguments were expected.")));
+  if (!args[0]->IsString())
+    return ThrowException(Exception::TypeError(
+        String::New("Input must be a string.")));
+  if (!args[1]->IsObject())
+    return ThrowException(Exception::TypeError(
+        String::New("Options must be an object.")));
+  if (!args[2]->IsFunction())
+    return ThrowException(Exception::TypeError(
+        String::New("Callback must be a function.")));
+
+  Local<Object> options = Local<Object>::Cast(args[1]);
+  LoadRequest *request = new LoadRequest(args[0]);
+  if (!InitializeParser(request->parser, request->input)) {
+    delete request;
+    return ThrowException(Exception::Error(
+        String::New("Could not initiaize libYAML")));
+  }
+  request->unique_keys = options->Get(unique_keys_symbol)->BooleanValue();
+  GetCancelOptions(options, request->cancel, request->abort_flag);
+  request->options = Persistent<Object>::New(options);
+  request->callback = Persistent<Function>::New(Local<Function>::Cast(args[2]));
+
+  request->work.data = request;
+  uv_queue_work(uv_default_loop(), &request->work, LoadWork, LoadDone);
+  return Undefined();
+}
+
+
+// Pipelined loading.
+//
+// The input is parsed on a thread of its own, which hands the new records to the main thread in
+// chunks, through a ring buffer without locks. The main thread builds documents from chunks as
+// they arrive, in slices of limited time, so parsing and building overlap, and other callbacks
+// run in between slices.
+
+// A full memory barrier, for the ring buffer.
+#ifdef _MSC_VER
+#define MEMORY_BARRIER() MemoryBarrier()
+#else
+#define MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+// Number of events parsed into each chunk.
+static const size_t PIPELINE_CHUNK_EVENTS = 1024;
+
+// Time the main thread spends building before it yields, by default.
+static const double PIPELINE_SLICE_MS = 5;
+
+// Records added to the tape since the previous chunk, along with their strings, tags and blobs.
+// String offsets are relative to the strings of the chunk. End records hold the final count of
+// their collection, and the index of its start record.
+struct TapeChunk {
+  std::vector<Record> records;
+  std::string strings;
+  std::vector<std::string> tags;
+  std::vector<Blob> blobs;
+
+  // Whether this is the last chunk, and whether parsing succeeded.
+  bool last;
+  int ok;
+
+  ~TapeChunk()
+  {
+    for (size_t i = 0; i < blobs.size(); i++)
+      free(blobs[i].data);
+  }
+};
+
+// Add the records of a chunk to a tape, and finish the collections they close.
+static void
+AppendChunk(Tape &tape, TapeChunk &chunk)
+{
+  uint32_t base = (uint32_t)tape.strings.size();
+  tape.strings.append(chunk.strings);
+  tape.tags.insert(tape.tags.end(), chunk.tags.begin(), chunk.tags.end());
+  tape.blobs.insert(tape.blobs.end(), chunk.blobs.begin(), chunk.blobs.end());
+  chunk.blobs.clear();
+
+  for (size_t i = 0; i < chunk.records.size(); i++) {
+    Record &record = chunk.records[i];
+    if (record.type == RECORD_STRING) {
+      record.data.string.offset += base;
+    }
+    else if (record.type == RECORD_END) {
+      Record &start = tape.records[record.data.collection.end];
+      start.data.collection.count = record.data.collection.count;
+      start.data.collection.end = (uint32_t)tape.records.size();
+      record.data.collection.count = 0;
+      record.data.collection.end = 0;
+    }
+    tape.records.push_back(record);
+  }
+}
+
+// A queue of chunks from one thread to another, without locks. Only the producer writes `tail_`,
+// and only the consumer writes `head_`.
+class ChunkRing
+{
+public:
+  ChunkRing() : head_(0), tail_(0) {}
+
+  // Add a chunk. Returns false if the ring is full.
+  bool
+  Push(TapeChunk *chunk)
+  {
+    size_t tail = tail_;
+    MEMORY_BARRIER();
+    if (tail - head_ == CAPACITY)
+      return false;
+    slots_[tail % CAPACITY] = chunk;
+    MEMORY_BARRIER();
+    tail_ = tail + 1;
+    return true;
+  }
+
+  // Take the oldest chunk. Returns NULL if the ring is empty.
+  TapeChunk *
+  Pop()
+  {
+    size_t head = head_;
+    MEMORY_BARRIER();
+    if (head == tail_)
+      return NULL;
+    MEMORY_BARRIER();
+    TapeChunk *chunk = slots_[head % CAPACITY];
+    MEMORY_BARRIER();
+    head_ = head + 1;
+    return chunk;
+  }
+
+private:
+  static const size_t CAPACITY = 64;
+
+  volatile size_t head_;
+  volatile size_t tail_;
+  TapeChunk *slots_[CAPACITY];
+};
+
+struct Pipeline {
+  String::Value input;
+  yaml_parser_t parser;
+  bool unique_keys;
+
+  // Owned by the parse thread, until it exits.
+  uv_thread_t thread;
+  Cancel parse_cancel;
+  Tape parsed;
+  std::vector<uint32_t> open;
+  size_t sent_records;
+  size_t sent_tags;
+  size_t sent_blobs;
+
+  // Shared by both threads. The parse thread waits on `space` while the ring is full.
+  ChunkRing ring;
+  uv_sem_t space;
+  uv_async_t async;
+  volatile bool stop;
+
+  // Owned by the main thread.
+  Cancel cancel;
+  Tape tape;
+  Builder *builder;
+  uint64_t slice;
+  bool last;
+  int ok;
+  bool finished;
+  Persistent<Object> abort_flag;
+  Persistent<Object> tag_handlers;
+  Persistent<Array> holder;
+  Persistent<Function> callback;
+
+  Pipeline(Handle<Value> value)
+    : input(value), sent_records(0), sent_tags(0), sent_blobs(0), stop(false), builder(NULL),
+      last(false), ok(0), finished(false)
+  {
+    uv_sem_init(&space, 0);
+  }
+
+  ~Pipeline()
+  {
+    TapeChunk *chunk;
+    while ((chunk = ring.Pop()) != NULL)
+      delete chunk;
+    delete builder;
+    yaml_parser_delete(&parser);
+    uv_sem_destroy(&space);
+  }
+};
+
+// Hand the records parsed since the previous chunk to the main thread. Waits while the ring is
+// full, unless the pipeline is stopped.
+static void
+SendChunk(Pipeline *pipeline, bool last, int ok)
+{
+  Tape &parsed = pipeline->parsed;
+  TapeChunk *chunk = new TapeChunk;
+  chunk->last = last;
+  chunk->ok = ok;
+
+  // The string pool starts over with each chunk.
+  chunk->strings.swap(parsed.strings);
+  chunk->tags.assign(parsed.tags.begin() + pipeline->sent_tags, parsed.tags.end());
+  pipeline->sent_tags = parsed.tags.size();
+  for (size_t i = pipeline->sent_blobs; i < parsed.blobs.size(); i++) {
+    chunk->blobs.push_back(parsed.blobs[i]);
+    parsed.blobs[i].data = NULL;
+  }
+  pipeline->sent_blobs = parsed.blobs.size();
+
+  chunk->records.assign(parsed.records.begin() + pipeline->sent_records, parsed.records.end());
+  for (size_t i = 0; i < chunk->records.size(); i++) {
+    Record &record = chunk->records[i];
+    switch (record.type) {
+      case RECORD_DOCUMENT:
+      case RECORD_SEQUENCE:
+      case RECORD_MAPPING:
+        pipeline->open.push_back((uint32_t)(pipeline->sent_records + i));
+        break;
+      case RECORD_END: {
+        uint32_t start = pipeline->open.back();
+        pipeline->open.pop_back();
+        record.data.collection.count = parsed.records[start].data.collection.count;
+        record.data.collection.end = start;
+        break;
+      }
+    }
+  }
+  pipeline->sent_records = parsed.records.size();
+
+  while (!pipeline->ring.Push(chunk)) {
+    if (pipeline->stop) {
+      delete chunk;
+      return;
+    }
+    uv_sem_wait(&pipeline->space);
+  }
+  uv_async_send(&pipeline->async);
+}
+
+// The parse thread.
+static void
+PipelineParse(void *arg)
+{
+  Pipeline *pipeline = (Pipeline *)arg;
+  TapeWriter writer(pipeline->parsed, pipeline->unique_keys);
+  yaml_event_t event;
+  size_t num_events = 0;
+  bool done = false;
+  int ok = 1;
+  while (!done && !pipeline->stop) {
+    if (num_events % CANCEL_CHECK_EVENTS == 0 && pipeline->parse_cancel.Check()) {
+      ok = 0;
+      break;
+    }
+    if (yaml_parser_parse(&pipeline->parser, &event) == 0) {
+      ok = 0;
+      break;
+    }
+    ok = writer.Write(pipeline->parser, event);
+    done = event.type == YAML_STREAM_END_EVENT;
+    yaml_event_delete(&event);
+    if (!ok)
+      break;
+    if (!done && ++num_events % PIPELINE_CHUNK_EVENTS == 0)
+      SendChunk(pipeline, false, 1);
+  }
+  if (!pipeline->stop)
+    SendChunk(pipeline, true, ok);
+}
+
+static void
+PipelineClosed(uv_handle_t *handle)
+{
+  delete (Pipeline *)handle->data;
+}
+
+// Stop and join the parse thread, and call back with the result.
+static void
+FinishPipeline(Pipeline *pipeline, Local<Value> params[2])
+{
+  pipeline->stop = true;
+  uv_sem_post(&pipeline->space);
+  uv_thread_join(&pipeline->thread);
+  pipeline->finished = true;
+
+  Local<Function> callback = Local<Function>::New(pipeline->callback);
+  pipeline->abort_flag.Dispose();
+  pipeline->tag_handlers.Dispose();
+  pipeline->holder.Dispose();
+  pipeline->callback.Dispose();
+  uv_close((uv_handle_t *)&pipeline->async, PipelineClosed);
+
+  TryCatch try_catch;
+  callback->Call(Context::GetCurrent()->Global(), 2, params);
+  if (try_catch.HasCaught())
+    FatalException(try_catch);
+}
+
+// Take the chunks that have arrived, and build for one slice on the main thread.
+static void
+PipelineStep(uv_async_t *handle, int status)
+{
+  Pipeline *pipeline = (Pipeline *)handle->data;
+  if (pipeline->finished)
+    return;
+
+  HandleScope scope;
+  uint64_t deadline = pipeline->cancel.Earliest(uv_hrtime() + pipeline->slice);
+
+  TapeChunk *chunk;
+  while ((chunk = pipeline->ring.Pop()) != NULL) {
+    uv_sem_post(&pipeline->space);
+    AppendChunk(pipeline->tape, *chunk);
+    if (chunk->last) {
+      pipeline->last = true;
+      pipeline->ok = chunk->ok;
+    }
+    delete chunk;
+  }
+
+  Local<Value> params[2] = { Local<Value>::New(Null()), Local<Value>::New(Null()) };
+  if (pipeline->cancel.Check()) {
+    params[0] = CancelToJs(pipeline->cancel.reason);
+    FinishPipeline(pipeline, params);
+    return;
+  }
+  if (pipeline->last && !pipeline->ok) {
+    // The parse thread leaves the parser alone after sending the last chunk.
+    params[0] = ParserErrorToJs(pipeline->parser);
+    FinishPipeline(pipeline, params);
+    return;
+  }
+
+  Builder *builder = pipeline->builder;
+  Local<Array> holder = Local<Array>::New(pipeline->holder);
+  builder->Resume(Local<Object>::New(pipeline->tag_handlers), holder);
+
+  int result;
+  {
+    TryCatch try_catch;
+    result = builder->Step(pipeline->last, deadline);
+    if (result == Builder::STEP_FAILED)
+      params[0] = try_catch.Exception();
+  }
+  if (result == Builder::STEP_DONE) {
+    params[1] = builder->Documents();
+  }
+  else if (result != Builder::STEP_FAILED) {
+    builder->Suspend(holder);
+    // Continue on the next turn of the event loop, unless waiting for the parser. Stopping at
+    // the deadline of `cancel` is reported then too.
+    if (result == Builder::STEP_PAUSED)
+      uv_async_send(&pipeline->async);
+    return;
+  }
+  FinishPipeline(pipeline, params);
+}
+
+// Pipelined version of `loadAsync`:
+//
+//     binding.loadPipelined(input, options, function(error, documents) { /* ... */ });
+//
+// The input is parsed on a new thread, while the documents are built on the main thread, in
+// slices of `options.sliceMs` milliseconds. Sequences that may become typed arrays or columns,
+// and mappings that may become `Map` instances by their size, are built only once they are
+// parsed in full. With `dedupe`, building waits for the whole input. Options to stop early are
+// those of `loadAsync`, and are checked by both threads.
+static Handle<Value>
+LoadPipelined(const Arguments &args)
+{
+  HandleScope scope;
+
+  // Check arguments.
+  if (args.Length() != 3)
+    return ThrowException(Exception::Error(
+        String::New("Three arguments were expected.")));
+  if (!args[0]->IsString())
+    return ThrowException(Exception::TypeError(
+        String::New("Input must be a string.")));
+  if (!args[1]->IsObject())
+    return ThrowException(Exception::TypeError(
+        String::New("Options must be an object.")));
+  if (!args[2]->IsFunction())
+    return ThrowException(Exception::TypeError(
+        String::New("Callback must be a function.")));
+
+  Local<Object> options = Local<Object>::Cast(args[1]);
+  Pipeline *pipeline = new Pipeline(args[0]);
+  if (!InitializeParser(pipeline->parser, pipeline->input)) {
+    delete pipeline;
+    return ThrowException(Exception::Error(
+        String::New("Could not initiaize libYAML")));
+  }
+  pipeline->unique_keys = options->Get(unique_keys_symbol)->BooleanValue();
+  Local<Value> slice = options->Get(slice_symbol);
+  double slice_ms = slice->IsNumber() ? slice->NumberValue() : PIPELINE_SLICE_MS;
+  pipeline->slice = (uint64_t)((slice_ms > 0 ? slice_ms : 0) * 1e6);
+  GetCancelOptions(options, pipeline->cancel, pipeline->abort_flag);
+  pipeline->parse_cancel = pipeline->cancel;
+
+  Local<Object> tag_handlers;
+  int flags;
+  uint32_t map_threshold;
+  GetBuildOptions(options, tag_handlers, flags, map_threshold);
+  pipeline->builder = new Builder(pipeline->tape, tag_handlers, flags, map_threshold);
+  Local<Array> holder = Array::New();
+  pipeline->builder->Suspend(holder);
+  pipeline->tag_handlers = Persistent<Object>::New(tag_handlers);
+  pipeline->holder = Persistent<Array>::New(holder);
+  pipeline->callback = Persistent<Function>::New(Local<Function>::Cast(args[2]));
+
+  pipeline->async.data = pipeline;
+  uv_async_init(uv_default_loop(), &pipeline->async, PipelineStep);
+  if (uv_thread_create(&pipeline->thread, PipelineParse, pipeline) != 0) {
+    pipeline->finished = true;
+    pipeline->abort_flag.Dispose();
+    pipeline->tag_handlers.Dispose();
+    pipeline->holder.Dispose();
+    pipeline->callback.Dispose();
+    uv_close((uv_handle_t *)&pipeline->async, PipelineClosed);
+    return ThrowException(Exception::Error(
+        String::New("Could not start a parser thread.")));
+  }
+  return Undefined();
+}
+
+
+// Incremental loading, on the main thread:
+//
+//     var loader = new binding.Loader(input, options);
+//     var documents = loader.step(budgetMs);
+//
+// Where threads are not an option, this parses and builds in steps of about `budgetMs`
+// milliseconds, keeping parser and builder state in between. `step` returns undefined until
+// done, then the array of documents. Options are those of `load`, and those of `loadAsync` to
+// stop early. As with `loadPipelined`, some collections are built only once they are parsed in
+// full, and `dedupe` builds all at once.
+class Loader : ObjectWrap
+{
+public:
+  static void
+  Initialize(Handle<Object> target)
+  {
+    Local<FunctionTemplate> t = FunctionTemplate::New(New);
+    t->InstanceTemplate()->SetInternalFieldCount(1);
+
+    NODE_SET_PROTOTYPE_METHOD(t, "step", Step);
+
+    target->Set(String::NewSymbol("Loader"), t->GetFunction());
+  }
+
+  virtual
+  ~Loader()
+  {
+    Finish();
+  }
+
+private:
+  // Number of events parsed between builder steps.
+  static const size_t STEP_EVENTS = 1024;
+
+  Loader(Handle<Value> input, bool unique_keys)
+    : input_(input), writer_(tape_, unique_keys), builder_(NULL), parsing_(false), done_(false) {}
+
+  static Handle<Value>
+  New(const Arguments &args)
+  {
+    HandleScope scope;
+
+    // Check arguments.
+    if (args.Length() != 2)
+      return ThrowException(Exception::Error(
+          String::New("Two arguments were expected.")));
+    if (!args[0]->IsString())
+      return ThrowException(Exception::TypeError(
+          String::New("Input must be a string.")));
+    if (!args[1]->IsObject())
+      return ThrowException(Exception::TypeError(
+          String::New("Options must be an object.")));
+
+    Local<Object> options = Local<Object>::Cast(args[1]);
+    Loader *loader = new Loader(args[0], options->Get(unique_keys_symbol)->BooleanValue());
+    if (!InitializeParser(loader->parser_, loader->input_)) {
+      delete loader;
+      return ThrowException(Exception::Error(
+          String::New("Could not initiaize libYAML")));
+    }
+    loader->parsing_ = true;
+    GetCancelOptions(options, loader->cancel_, loader->abort_flag_);
+
+    Local<Object> tag_handlers;
+    int flags;
+    uint32_t map_threshold;
+    GetBuildOptions(options, tag_handlers, flags, map_threshold);
+    loader->builder_ = new Builder(loader->tape_, tag_handlers, flags, map_threshold);
+    Local<Array> holder = Array::New();
+    loader->builder_->Suspend(holder);
+    loader->tag_handlers_ = Persistent<Object>::New(tag_handlers);
+    loader->holder_ = Persistent<Array>::New(holder);
+
+    loader->Wrap(args.This());
+    return args.This();
+  }
+
+  static Handle<Value>
+  Step(const Arguments &args)
+  {
+    HandleScope scope;
+
+    Loader *loader = ObjectWrap::Unwrap<Loader>(args.This());
+    if (loader->done_)
+      return ThrowException(Exception::Error(
+          String::New("Loading has already finished.")));
+
+    double budget = args.Length() > 0 && args[0]->IsNumber() ? args[0]->NumberValue() : 0;
+    uint64_t deadline = uv_hrtime() + (uint64_t)((budget > 0 ? budget : 0) * 1e6);
+    deadline = loader->cancel_.Earliest(deadline);
+
+    Builder *builder = loader->builder_;
+    Local<Array> holder = Local<Array>::New(loader->holder_);
+    builder->Resume(Local<Object>::New(loader->tag_handlers_), holder);
+
+    // Alternate between parsing a batch of events and building from them.
+    while (!loader->cancel_.Check()) {
+      if (loader->parsing_ && !loader->Parse()) {
+        if (loader->cancel_.reason != CANCEL_NONE)
+          break;
+        ThrowException(ParserErrorToJs(loader->parser_));
+        loader->Finish();
+        return Undefined();
+      }
+
+      int result = builder->Step(!loader->parsing_, deadline);
+      if (result == Builder::STEP_FAILED) {
+        loader->Finish();
+        return Undefined();
+      }
+      if (result == Builder::STEP_DONE) {
+        Local<Array> documents = builder->Documents();
+        loader->Finish();
+        return scope.Close(documents);
+      }
+      if ((result == Builder::STEP_PAUSED || uv_hrtime() >= deadline)
+          && !loader->cancel_.Check()) {
+        builder->Suspend(holder);
+        return Undefined();
+      }
+    }
+
+    ThrowException(CancelToJs(loader->cancel_.reason));
+    loader->Finish();
+    return Undefined();
+  }
+
+  // Parse the next batch of events onto the tape. Returns 0 on failure, with the parser error
+  // set, or the reason in `cancel_`.
+  int
+  Parse()
+  {
+    yaml_event_t event;
+    for (size_t i = 0; i < STEP_EVENTS; i++) {
+      if (i % CANCEL_CHECK_EVENTS == 0 && cancel_.Check())
+        return 0;
+      if (yaml_parser_parse(&parser_, &event) == 0)
+        return 0;
+
+      int ok = writer_.Write(parser_, event);
+      yaml_event_type_t type = event.type;
+      yaml_event_delete(&event);
+      if (!ok)
+        return 0;
+      if (type == YAML_STREAM_END_EVENT) {
+        yaml_parser_delete(&parser_);
+        parsing_ = false;
+        break;
+      }
+    }
+    return 1;
+  }
+
+  // Release parser and builder state.
+  void
+  Finish()
+  {
+    if (parsing_)
+      yaml_parser_delete(&parser_);
+    parsing_ = false;
+    delete builder_;
+    builder_ = NULL;
+    abort_flag_.Dispose();
+    abort_flag_.Clear();
+    tag_handlers_.Dispose();
+    tag_handlers_.Clear();
+    holder_.Dispose();
+    holder_.Clear();
+    done_ = true;
+  }
+
+  String::Value input_;
+  yaml_parser_t parser_;
+  Tape tape_;
+  TapeWriter writer_;
+  Builder *builder_;
+  bool parsing_;
+  bool done_;
+  Cancel cancel_;
+  Persistent<Object> abort_flag_;
+  Persistent<Object> tag_handlers_;
+  Persistent<Array> holder_;
+};
+
+
+// Map a file into memory, read-only. Returns NULL on failure, with `errno` set. Where there is no
+// `mmap`, the file is read into memory instead.
+static void *
+MapFile(const char *path, size_t &length)
+{
+#ifdef _WIN32
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return NULL;
+  void *data = NULL;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long size = ftell(file);
+    if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+      length = (size_t)size;
+      data = malloc(length);
+      if (data != NULL && fread(data, 1, length, file) != length) {
+        free(data);
+        data = NULL;
+      }
+    }
+  }
+  if (data == NULL && errno == 0)
+    errno = EINVAL;
+  fclose(file);
+  return data;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  void *data = NULL;
+  if (fstat(fd, &st) == 0) {
+    if (st.st_size == 0) {
+      errno = EINVAL;
+    }
+    else {
+      length = (size_t)st.st_size;
+      data = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED)
+        data = NULL;
+    }
+  }
+  int saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return data;
+#endif
+}
+
+static void
+UnmapFile(void *data, size_t length)
+{
+#ifdef _WIN32
+  free(data);
+#else
+  munmap(data, length);
+#endif
+}
+
+
+// A tape shared by the lazy nodes of a stream. It is deleted along with the last of its nodes.
+//
+// Nodes read the tape through plain pointers, so that it can also be a compiled tape that is read
+// in place, from a mapped snapshot file or a Buffer.
+struct SharedTape {
+  const Record *records;
+  uint32_t num_records;
+  const char *strings;
+  Blob *blobs;
+
+  // The tape, unless it is mapped.
+  Tape tape;
+
+  // A compiled tape: the mapping or Buffer it is in, and its blobs.
+  void *mapping;
+  size_t mapping_length;
+  Persistent<Object> buffer;
+  std::vector<Blob> mapped_blobs;
+
+  int refs;
+
+  // Memory reported to V8 as held by the tape.
+  intptr_t size;
+
+  SharedTape()
+    : records(NULL), num_records(0), strings(NULL), blobs(NULL), mapping(NULL), mapping_length(0),
+      refs(0), size(0) {}
+
+  ~SharedTape()
+  {
+    V8::AdjustAmountOfExternalAllocatedMemory(-size);
+    if (mapping != NULL)
+      UnmapFile(mapping, mapping_length);
+    if (!buffer.IsEmpty())
+      buffer.Dispose();
+  }
+
+  // Read from `tape`, once it is complete, and report the memory it holds to V8.
+  void
+  UseTape()
+  {
+    records = tape.records.empty() ? NULL : &tape.records[0];
+    num_records = (uint32_t)tape.records.size();
+    strings = tape.strings.data();
+    blobs = tape.blobs.empty() ? NULL : &tape.blobs[0];
+
+    size_t total = tape.records.size() * sizeof(Record) + tape.strings.size();
+    for (size_t i = 0; i < tape.blobs.size(); i++)
+      total += tape.blobs[i].length;
+    size = (intptr_t)total;
+    V8::AdjustAmountOfExternalAllocatedMemory(size);
+  }
+
+  // Read from a mapped compiled tape in place. The mapping is not reported to V8, because it is
+  // backed by the file. Returns false if the file is not a compiled tape for this build. The
+  // mapping is owned by the tape either way.
+  bool
+  UseMapping(void *data, size_t length)
+  {
+    mapping = data;
+    mapping_length = length;
+    return UseCompiled((const char *)data, length);
+  }
+
+  // Read from a compiled tape in a Buffer in place, and keep the Buffer alive. The input must be
+  // 8-byte aligned. Returns false if it is not a compiled tape for this build.
+  bool
+  UseBuffer(Handle<Object> object, const char *input, size_t length)
+  {
+    buffer = Persistent<Object>::New(object);
+    return UseCompiled(input, length);
+  }
+
+  // Read from a compiled tape in place. Records are only checked, not copied.
+  bool
+  UseCompiled(const char *input, size_t length)
+  {
+    TapeHeader header;
+    size_t ranges_offset, data_offset;
+    if (!CheckCompiledHeader(input, length, header, ranges_offset, data_offset))
+      return false;
+
+    const TapeRange *ranges = (const TapeRange *)(input + ranges_offset);
+    const char *blob_data = input + data_offset;
+    mapped_blobs.resize(header.num_blobs);
+    for (uint32_t i = 0; i < header.num_blobs; i++) {
+      const TapeRange &range = ranges[header.num_tags + i];
+      if (!CheckRange(range, header))
+        return false;
+      mapped_blobs[i].data = (char *)blob_data + range.offset;
+      mapped_blobs[i].length = range.length;
+    }
+
+    records = (const Record *)(input + sizeof(header));
+    if (!CheckRecords(records, header.num_records, header))
+      return false;
+    strings = input + data_offset;
+    blobs = mapped_blobs.empty() ? NULL : &mapped_blobs[0];
+    num_records = header.num_records;
+    return true;
+  }
+};
+
+
+// A sequence or mapping of a tape, as an object that builds its children only when they are
+// accessed. The object has interceptors instead of properties: mappings have named properties
+// for their keys, and sequences have indexed properties and a `length`. Children are built once,
+// and kept in a cache object in the second internal field.
+class LazyNode : ObjectWrap
+{
+public:
+  static void
+  Initialize()
+  {
+    mapping_template_ = Persistent<ObjectTemplate>::New(ObjectTemplate::New());
+    mapping_template_->SetInternalFieldCount(2);
+    mapping_template_->SetNamedPropertyHandler(
+        MappingGetter, NamedSetter, MappingQuery, NamedDeleter, MappingEnumerator);
+    mapping_template_->SetIndexedPropertyHandler(
+        MappingIndexedGetter, IndexedSetter, MappingIndexedQuery, IndexedDeleter,
+        MappingIndexedEnumerator);
+
+    sequence_template_ = Persistent<ObjectTemplate>::New(ObjectTemplate::New());
+    sequence_template_->SetInternalFieldCount(2);
+    sequence_template_->SetNamedPropertyHandler(
+        SequenceNamedGetter, NamedSetter, SequenceNamedQuery, NamedDeleter);
+    sequence_template_->SetIndexedPropertyHandler(
+        SequenceGetter, IndexedSetter, SequenceQuery, IndexedDeleter, SequenceEnumerator);
+  }
+
+  // Create the value of a record. Collections become lazy nodes, aliases resolve to their anchor,
+  // and scalars are copied out of the tape.
+  static Local<Value>
+  Materialize(SharedTape *shared, uint32_t index)
+  {
+    const Record *record = &shared->records[index];
+    if (record->type == RECORD_ALIAS) {
+      index = record->data.target;
+      record = &shared->records[index];
+    }
+
+    if (record->type != RECORD_SEQUENCE && record->type != RECORD_MAPPING)
+      return RecordToJs(shared->strings, shared->blobs, *record, false);
+
+    Persistent<ObjectTemplate> &t =
+        (record->type == RECORD_SEQUENCE) ? sequence_template_ : mapping_template_;
+    Local<Object> obj = t->NewInstance();
+    obj->SetInternalField(1, Object::New());
+
+    LazyNode *node = new LazyNode(shared, index);
+    node->Wrap(obj);
+    return obj;
+  }
+
+  virtual
+  ~LazyNode()
+  {
+    if (--shared_->refs == 0)
+      delete shared_;
+  }
+
+private:
+  LazyNode(SharedTape *shared, uint32_t index)
+    : shared_(shared), index_(index), indexed_(false)
+  {
+    shared_->refs++;
+  }
+
+  // Index of the record after the node starting at `index`.
+  uint32_t
+  Next(uint32_t index)
+  {
+    const Record &record = shared_->records[index];
+    if (record.type == RECORD_SEQUENCE || record.type == RECORD_MAPPING)
+      return record.data.collection.end + 1;
+    return index + 1;
+  }
+
+  // Find the children of the node, on first access. Only scalar keys of mappings are indexed,
+  // and of keys that occur more than once, the last one wins, like in regular documents.
+  void
+  Index()
+  {
+    if (indexed_)
+      return;
+    indexed_ = true;
+
+    const Record &start = shared_->records[index_];
+    uint32_t end = start.data.collection.end;
+    if (start.type == RECORD_SEQUENCE) {
+      items_.reserve(start.data.collection.count);
+      for (uint32_t i = index_ + 1; i < end; i = Next(i))
+        items_.push_back(i);
+      return;
+    }
+
+    for (uint32_t i = index_ + 1; i < end; ) {
+      uint32_t value = Next(i);
+      std::string name;
+      if (KeyName(i, name)) {
+        std::pair<std::map<std::string, uint32_t>::iterator, bool> result =
+            keys_.insert(std::make_pair(name, value));
+        if (result.second)
+          names_.push_back(&result.first->first);
+        else
+          result.first->second = value;
+      }
+      i = Next(value);
+    }
+  }
+
+  // Get the property name of a mapping key. Returns false for keys that are collections.
+  bool
+  KeyName(uint32_t index, std::string &name)
+  {
+    const Record *record = &shared_->records[index];
+    if (record->type == RECORD_ALIAS)
+      record = &shared_->records[record->data.target];
+
+    switch (record->type) {
+      case RECORD_SEQUENCE:
+      case RECORD_MAPPING:
+        return false;
+      case RECORD_STRING:
+        name.assign(shared_->strings + record->data.string.offset, record->data.string.length);
+        return true;
+      case RECORD_EXTERNAL_STRING: {
+        Blob &blob = shared_->blobs[record->data.blob];
+        name.assign(blob.data, blob.length);
+        return true;
+      }
+      default: {
+        HandleScope scope;
+        String::Utf8Value value(RecordToJs(shared_->strings, shared_->blobs, *record, false));
+        name.assign(*value, value.length());
+        return true;
+      }
+    }
+  }
+
+  // Get the value of a child, from the cache or by building it.
+  static Handle<Value>
+  Child(const AccessorInfo &info, uint32_t index)
+  {
+    HandleScope scope;
+    LazyNode *node = ObjectWrap::Unwrap<LazyNode>(info.Holder());
+    Local<Object> cache = Local<Object>::Cast(info.Holder()->GetInternalField(1));
+    Local<Value> value = cache->Get(index);
+    if (value->IsUndefined()) {
+      value = Materialize(node->shared_, index);
+      cache->Set(index, value);
+    }
+    return scope.Close(value);
+  }
+
+  // Look up the record of the value of a mapping key. Returns false if there is no such key.
+  static bool
+  FindKey(const std::string &name, const AccessorInfo &info, uint32_t &index)
+  {
+    LazyNode *node = ObjectWrap::Unwrap<LazyNode>(info.Holder());
+    node->Index();
+    std::map<std::string, uint32_t>::iterator it = node->keys_.find(name);
+    if (it == node->keys_.end())
+      return false;
+    index = it->second;
+    return true;
+  }
+
+  static bool
+  FindKey(Local<String> property, const AccessorInfo &info, uint32_t &index)
+  {
+    String::Utf8Value name(property);
+    return FindKey(std::string(*name, name.length()), info, index);
+  }
+
+  // V8 passes property names that are array indices, eg. `1`, to the indexed handlers.
+  static bool
+  FindKey(uint32_t property, const AccessorInfo &info, uint32_t &index)
+  {
+    char name[16];
+    sprintf(name, "%u", property);
+    return FindKey(std::string(name), info, index);
+  }
+
+  // Check whether a key is an array index, and so enumerated by the indexed handler.
+  static bool
+  IsArrayIndex(const std::string &name, uint32_t &index)
+  {
+    if (name.empty() || name.size() > 10 || (name[0] == '0' && name.size() > 1))
+      return false;
+    uint64_t value = 0;
+    for (size_t i = 0; i < name.size(); i++) {
+      if (name[i] < '0' || name[i] > '9')
+        return false;
+      value = value * 10 + (name[i] - '0');
+    }
+    if (value >= 0xFFFFFFFFULL)
+      return false;
+    index = (uint32_t)value;
+    return true;
+  }
+
+  static Handle<Value>
+  MappingGetter(Local<String> property, const AccessorInfo &info)
+  {
+    uint32_t index;
+    if (!FindKey(property, info, index))
+      return Handle<Value>();
+    return Child(info, index);
+  }
+
+  static Handle<Integer>
+  MappingQuery(Local<String> property, const AccessorInfo &info)
+  {
+    uint32_t index;
+    if (!FindKey(property, info, index))
+      return Handle<Integer>();
+    return Integer::New(ReadOnly | DontDelete);
+  }
+
+  static Handle<Array>
+  MappingEnumerator(const AccessorInfo &info)
+  {
+    HandleScope scope;
+    LazyNode *node = ObjectWrap::Unwrap<LazyNode>(info.Holder());
+    node->Index();
+    Local<Array> names = Array::New();
+    uint32_t length = 0;
+    for (size_t i = 0; i < node->names_.size(); i++) {
+      const std::string &name = *node->names_[i];
+      uint32_t index;
+      if (!IsArrayIndex(name, index))
+        names->Set(length++, String::New(name.data(), (int)name.size()));
+    }
+    return scope.Close(names);
+  }
+
+  static Handle<Value>
+  MappingIndexedGetter(uint32_t property, const AccessorInfo &info)
+  {
+    uint32_t index;
+    if (!FindKey(property, info, index))
+      return Handle<Value>();
+    return Child(info, index);
+  }
+
+  static Handle<Integer>
+  MappingIndexedQuery(uint32_t property, const AccessorInfo &info)
+  {
+    uint32_t index;
+    if (!FindKey(property, info, index))
+      return Handle<Integer>();
+    return Integer::New(ReadOnly | DontDelete);
+  }
+
+  // Keys that are array indices come first, in ascending order, like those of regular objects.
+  static Handle<Array>
+  MappingIndexedEnumerator(const AccessorInfo &info)
+  {
+    HandleScope scope;
+    LazyNode *node = ObjectWrap::Unwrap<LazyNode>(info.Holder());
+    node->Index();
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < node->names_.size(); i++) {
+      uint32_t index;
+      if (IsArrayIndex(*node->names_[i], index))
+        indices.push_back(index);
+    }
+    std::sort(indices.begin(), indices.end());
+    Local<Array> result = Array::New((int)indices.size());
+    for (uint32_t i = 0; i < indices.size(); i++)
+      result->Set(i, Integer::NewFromUnsigned(indices[i]));
+    return scope.Close(result);
+  }
+
+  static Handle<Value>
+  SequenceNamedGetter(Local<String> property, const AccessorInfo &info)
+  {
+    if (!property->Equals(length_symbol))
+      return Handle<Value>();
+    LazyNode *node = ObjectWrap::Unwrap<LazyNode>(info.Holder());
+    const Record &record = node->shared_->records[node->index_];
+    return Integer::NewFromUnsigned(record.data.collection.count);
+  }
+
+  static Handle<Integer>
+  SequenceNamedQuery(Local<String> property, const AccessorInfo &info)
+  {
+    if (!property->Equals(length_symbol))
+      return Handle<Integer>();
+    return Integer::New(ReadOnly | DontEnum | DontDelete);
+  }
+
+  static Handle<Value>
+  SequenceGetter(uint32_t index, const AccessorInfo &info)
+  {
+    LazyNode *node = ObjectWrap::Unwrap<LazyNode>(info.Holder());
+    node->Index();
+    if (index >= node->items_.size())
+      return Handle<Value>();
+    return Child(info, node->items_[index]);
+  }
+
+  static Handle<Integer>
+  SequenceQuery(uint32_t index, const AccessorInfo &info)
+  {
+    LazyNode *node = ObjectWrap::Unwrap<LazyNode>(info.Holder());
+    const Record &record = node->shared_->records[node->index_];
+    if (index >= record.data.collection.count)
+      return Handle<Integer>();
+    return Integer::New(ReadOnly | DontDelete);
+  }
+
+  static Handle<Array>
+  SequenceEnumerator(const AccessorInfo &info)
+  {
+    HandleScope scope;
+    LazyNode *node = ObjectWrap::Unwrap<LazyNode>(info.Holder());
+    const Record &record = node->shared_->records[node->index_];
+    uint32_t length = record.data.collection.count;
+    Local<Array> indices = Array::New(length);
+    for (uint32_t i = 0; i < length; i++)
+      indices->Set(i, Integer::NewFromUnsigned(i));
+    return scope.Close(indices);
+  }
+
+  // Lazy nodes are views of the tape, and cannot be modified.
+  static Handle<Value>
+  NamedSetter(Local<String> property, Local<Value> value, const AccessorInfo &info)
+  {
+    return ThrowException(Exception::TypeError(
+        String::New("Lazy documents are read-only.")));
+  }
+
+  static Handle<Value>
+  IndexedSetter(uint32_t index, Local<Value> value, const AccessorInfo &info)
+  {
+    return ThrowException(Exception::TypeError(
+        String::New("Lazy documents are read-only.")));
+  }
+
+  static Handle<Boolean>
+  NamedDeleter(Local<String> property, const AccessorInfo &info)
+  {
+    return False();
+  }
+
+  static Handle<Boolean>
+  IndexedDeleter(uint32_t index, const AccessorInfo &info)
+  {
+    return False();
+  }
+
+private:
+  static Persistent<ObjectTemplate> mapping_template_;
+  static Persistent<ObjectTemplate> sequence_template_;
+
+  SharedTape *shared_;
+
+  // Index of the start record.
+  uint32_t index_;
+
+  // Children, once indexed. Sequences have the records of their items, and mappings the records
+  // of their values by key, plus the keys in order of first occurrence.
+  bool indexed_;
+  std::vector<uint32_t> items_;
+  std::map<std::string, uint32_t> keys_;
+  std::vector<const std::string *> names_;
+};
+
+Persistent<ObjectTemplate> LazyNode::mapping_template_;
+Persistent<ObjectTemplate> LazyNode::sequence_template_;
+
+
+// Create the root nodes of the documents on a shared tape. The tape lives on for as long as any
+// of its nodes, and is deleted right away if there are none.
+static Local<Array>
+LazyDocuments(SharedTape *shared)
+{
+  const Record *records = shared->records;
+  uint32_t size = shared->num_records;
+  Local<Array> documents = Array::New();
+  uint32_t num_documents = 0;
+  shared->refs++;
+  for (uint32_t i = 0; i < size; i = records[i].data.collection.end + 1)
+    documents->Set(num_documents++, LazyNode::Materialize(shared, i + 1));
+  if (--shared->refs == 0)
+    delete shared;
+  return documents;
+}
+
+// Load all documents from a string, like `load`, but without building them. The return value
+// is an array of the root nodes of the documents, as lazy nodes where they are collections.
+//
+// The whole input is parsed up front, so syntax errors are thrown from here. Scalars are
+// resolved as in `load`, but tag handlers are not supported.
+static Handle<Value>
+LoadLazy(const Arguments &args)
+{
+  HandleScope scope;
+
+  // Check arguments.
+  if (args.Length() != 1)
+    return ThrowException(Exception::Error(
+        String::New("One argument was expected.")));
+  if (!args[0]->IsString())
+    return ThrowException(Exception::TypeError(
+        String::New("Input must be a string.")));
+
+  // Parse the input into a tape.
+  SharedTape *shared = new SharedTape();
+  if (!ParseStringToTape(args[0], shared->tape, false)) {
+    delete shared;
+    return Undefined();
+  }
+  shared->UseTape();
+
+  return scope.Close(LazyDocuments(shared));
+}
+
+// Open a snapshot file, which holds the output of `compile`:
+//
+//     var documents = binding.openSnapshot(path);
+//
+// The return value is like that of `loadLazy`. The file is mapped into memory, and nodes read
+// from it in place, so processes that open the same snapshot share a single copy of it in the
+// page cache. Only scalars that are accessed are copied onto the V8 heap.
+//
+// The file must not be modified while it is open. Replace it with a new file instead.
+static Handle<Value>
+OpenSnapshot(const Arguments &args)
+{
+  HandleScope scope;
+
+  // Check arguments.
+  if (args.Length() != 1)
+    return ThrowException(Exception::Error(
+        String::New("One argument was expected.")));
+  if (!args[0]->IsString())
+    return ThrowException(Exception::TypeError(
+        String::New("Path must be a string.")));
+
+  String::Utf8Value path(args[0]);
+  size_t length = 0;
+  errno = 0;
+  void *data = MapFile(*path, length);
+  if (data == NULL)
+    return ThrowException(ErrnoException(errno, "mmap", "", *path));
+
+  SharedTape *shared = new SharedTape();
+  if (!shared->UseMapping(data, length)) {
+    delete shared;
+    return ThrowException(Exception::Error(
+        String::New("File is not a valid snapshot for this build.")));
+  }
+
+  return scope.Close(LazyDocuments(shared));
+}
+
+// Read the output of `compile` from a Buffer:
+//
+//     var documents = binding.readTape(compiled);
+//
+// The return value is like that of `loadLazy`. Nodes read from the Buffer in place, and keep it
+// alive, so any number of readers can share one copy of a tape. If the Buffer is not suitably
+// aligned, the tape is copied out of it instead.
+//
+// The Buffer must not be modified while nodes read from it.
+static Handle<Value>
+ReadTape(const Arguments &args)
+{
+  HandleScope scope;
+
+  // Check arguments.
+  if (args.Length() != 1)
+    return ThrowException(Exception::Error(
+        String::New("One argument was expected.")));
+  const uint8_t *data;
+  size_t length;
+  if (!GetByteArrayData(args[0], data, length))
+    return ThrowException(Exception::TypeError(
+        String::New("Input must be a Buffer.")));
+
+  SharedTape *shared = new SharedTape();
+  bool ok;
+  if (((uintptr_t)data & 7) == 0) {
+    ok = shared->UseBuffer(Local<Object>::Cast(args[0]), (const char *)data, length);
+  }
+  else {
+    ok = LoadCompiledTape((const char *)data, length, shared->tape);
+    if (ok)
+      shared->UseTape();
+  }
+  if (!ok) {
+    delete shared;
+    return ThrowException(Exception::Error(
+        String::New("Input is not a valid compiled YAML stream.")));
+  }
+
+  return scope.Close(LazyDocuments(shared));
+}
+
+
+// Binding to LibYAML's stream emitter. The usage is more or less the opposite of `parse`:
+//
+//     var emitter = new Emitter(function(data) { /* ... */ };
+//     emitter.event({ type: 'streamStart' });
+//
+// The constructor takes a function called with output data as LibYAML provides it.
+class Emitter : ObjectWrap
+{
+public:
+  static void
+  Initialize(Handle<Object> target)
+  {
+    Local<FunctionTemplate> t = FunctionTemplate::New(New);
+    t->InstanceTemplate()->SetInternalFieldCount(1);
+
+    NODE_SET_PROTOTYPE_METHOD(t, "event", Event);
+
+    target->Set(String::NewSymbol("Emitter"), t->GetFunction());
+  }
+
+  virtual
+  ~Emitter()
+  {
+    writeCallback_.Dispose();
+    yaml_emitter_delete(&emitter_);
+  }
+
+private:
+  Emitter() {}
+
+  static Handle<Value>
+  New(const Arguments &args)
+  {
+    if (args.Length() != 1)
+      return ThrowException(Exception::TypeError(
+          String::New("Expected one argument")));
+    if (!args[0]->IsFunction())
+      return ThrowException(Exception::TypeError(
+          String::New("Expected a function")));
+
+    Emitter *e = new Emitter();
+
+    if (!yaml_emitter_initialize(&e->emitter_))
+      return ThrowException(Exception::Error(
+          String::New("Could not initiaize libYAML")));
+    // FIXME: Detect endianness?
+    yaml_emitter_set_encoding(&e->emitter_, YAML_UTF16LE_ENCODING);
+    // Don't escape unicode in output
+    yaml_emitter_set_unicode(&e->emitter_, 1);
+    yaml_emitter_set_output(&e->emitter_, WriteHandler, e);
+
+    e->writeCallback_ = Persistent<Function>::New(
+        Handle<Function>::Cast(args[0]));
+
+    e->Wrap(args.This());
+    return e->handle_;
+  }
+
+  static Handle<Value>
+  Event(const Arguments &args)
+  {
+    if (args.Length() != 1)
+      return ThrowException(Exception::TypeError(
+          String::New("Expected one argument")));
+    if (!args[0]->IsObject())
+      return ThrowException(Exception::TypeError(
+          String::New("Expected an object")));
+    Local<Object> obj = Local<Object>::Cast(args[0]);
+
+    Emitter *e = ObjectWrap::Unwrap<Emitter>(args.This());
+
+    yaml_event_t *ev = JsToEvent(obj);
+    if (yaml_emitter_emit(&e->emitter_, ev) == 0)
+      return ThrowException(EmitterErrorToJs(e->emitter_));
+
+    return Undefined();
+  }
 
   static int
   WriteHandler(void *data, unsigned char *buffer, size_t size)
@@ -571,9 +5028,72 @@ Initialize(Handle<Object> target)
   problem_symbol     = NODE_PSYMBOL("problem");
   description_symbol = NODE_PSYMBOL("description");
 
+  handler_method_symbols[YAML_STREAM_START_EVENT]   = NODE_PSYMBOL("onStreamStart");
+  handler_method_symbols[YAML_STREAM_END_EVENT]     = NODE_PSYMBOL("onStreamEnd");
+  handler_method_symbols[YAML_DOCUMENT_START_EVENT] = NODE_PSYMBOL("onDocumentStart");
+  handler_method_symbols[YAML_DOCUMENT_END_EVENT]   = NODE_PSYMBOL("onDocumentEnd");
+  handler_method_symbols[YAML_ALIAS_EVENT]          = NODE_PSYMBOL("onAlias");
+  handler_method_symbols[YAML_SCALAR_EVENT]         = NODE_PSYMBOL("onScalar");
+  handler_method_symbols[YAML_SEQUENCE_START_EVENT] = NODE_PSYMBOL("onSequenceStart");
+  handler_method_symbols[YAML_SEQUENCE_END_EVENT]   = NODE_PSYMBOL("onSequenceEnd");
+  handler_method_symbols[YAML_MAPPING_START_EVENT]  = NODE_PSYMBOL("onMappingStart");
+  handler_method_symbols[YAML_MAPPING_END_EVENT]    = NODE_PSYMBOL("onMappingEnd");
+
+  marks_symbol  = NODE_PSYMBOL("marks");
+  fields_symbol = NODE_PSYMBOL("fields");
+  flyweight_symbol = NODE_PSYMBOL("flyweight");
+
+  tag_handlers_symbol  = NODE_PSYMBOL("tagHandlers");
+  typed_arrays_symbol  = NODE_PSYMBOL("typedArrays");
+  columnar_symbol      = NODE_PSYMBOL("columnar");
+  maps_symbol          = NODE_PSYMBOL("maps");
+  unique_keys_symbol   = NODE_PSYMBOL("uniqueKeys");
+  dedupe_symbol        = NODE_PSYMBOL("dedupe");
+  buffer_symbol        = NODE_PSYMBOL("Buffer");
+  int32_array_symbol   = NODE_PSYMBOL("Int32Array");
+  float64_array_symbol = NODE_PSYMBOL("Float64Array");
+  map_symbol           = NODE_PSYMBOL("Map");
+  prototype_symbol     = NODE_PSYMBOL("prototype");
+  set_symbol           = NODE_PSYMBOL("set");
+  object_symbol        = NODE_PSYMBOL("Object");
+  freeze_symbol        = NODE_PSYMBOL("freeze");
+  length_symbol        = NODE_PSYMBOL("length");
+  slice_symbol         = NODE_PSYMBOL("sliceMs");
+  abort_flag_symbol    = NODE_PSYMBOL("abortFlag");
+  timeout_symbol       = NODE_PSYMBOL("timeoutMs");
+  code_symbol          = NODE_PSYMBOL("code");
+
+  InitializeBase64();
+  LazyNode::Initialize();
+
   Local<FunctionTemplate> parse_template = FunctionTemplate::New(Parse);
   target->Set(String::NewSymbol("parse"), parse_template->GetFunction());
 
+  Local<FunctionTemplate> load_template = FunctionTemplate::New(Load);
+  target->Set(String::NewSymbol("load"), load_template->GetFunction());
+
+  Local<FunctionTemplate> load_async_template = FunctionTemplate::New(LoadAsync);
+  target->Set(String::NewSymbol("loadAsync"), load_async_template->GetFunction());
+
+  Local<FunctionTemplate> load_pipelined_template = FunctionTemplate::New(LoadPipelined);
+  target->Set(String::NewSymbol("loadPipelined"), load_pipelined_template->GetFunction());
+
+  Local<FunctionTemplate> load_lazy_template = FunctionTemplate::New(LoadLazy);
+  target->Set(String::NewSymbol("loadLazy"), load_lazy_template->GetFunction());
+
+  Local<FunctionTemplate> compile_template = FunctionTemplate::New(Compile);
+  target->Set(String::NewSymbol("compile"), compile_template->GetFunction());
+
+  Local<FunctionTemplate> load_compiled_template = FunctionTemplate::New(LoadCompiled);
+  target->Set(String::NewSymbol("loadCompiled"), load_compiled_template->GetFunction());
+
+  Local<FunctionTemplate> open_snapshot_template = FunctionTemplate::New(OpenSnapshot);
+  target->Set(String::NewSymbol("openSnapshot"), open_snapshot_template->GetFunction());
+
+  Local<FunctionTemplate> read_tape_template = FunctionTemplate::New(ReadTape);
+  target->Set(String::NewSymbol("readTape"), read_tape_template->GetFunction());
+
+  Loader::Initialize(target);
   Emitter::Initialize(target);
 }
 
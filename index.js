@@ -2,6 +2,8 @@
 // MIT-licensed. (See the included LICENSE file.)
 
 var fs = require('fs');
+var path = require('path');
+var crypto = require('crypto');
 var util = require('util');
 var events = require('events');
 var binding = require('./build/Release/binding');
@@ -17,25 +19,85 @@ YAML.stream = {};
 
 // Create a raw event stream from YAML input.
 //
-//     var output = yaml.stream.parse(input, handler);
+//     var completed = yaml.stream.parse(input, handler);
 //
 // The handler can be an object that exposes methods for each LibYAML parser event. These are
 // named `onScalar`, `onSequenceStart`, etc. All of these methods take an event object that is
-// similar in structure to a flattened `yaml_event_t`.
+// similar in structure to a flattened `yaml_event_t`. The methods are looked up once, when
+// parsing starts, and events without a method are skipped.
 //
 // Alternatively, a single function can be passed in to handle all events.
-YAML.stream.parse = function(input, handler) {
-  if (typeof(handler) !== 'function') {
-    var orig = handler;
-    handler = function(event) {
-      var type = event.type;
-      var method = 'on' + type.charAt(0).toUpperCase() + type.slice(1);
-      if (typeof(orig[method]) === 'function')
-        orig[method](event);
-    };
-  }
+//
+// A handler may return `false` to stop parsing early, in which case `parse` returns `false`.
+// Otherwise, it returns `true` once the whole input was parsed.
+//
+// An optional `options` object may be passed as well. Setting `marks: 'index'` in it makes the
+// `start` and `end` of each event a plain character index rather than a full mark object. Use
+// `createLocator` to turn these into line and column numbers when they are actually needed.
+//
+// Events can also be limited to a subset of their properties using `fields`, for example
+// `{ fields: ['type', 'value'] }`. Other properties are then never created.
+//
+// With `flyweight: true`, a single event object is reused for all events and only its properties
+// change. Handlers must copy out anything they want to keep, but parsing creates no garbage
+// event objects.
+YAML.stream.parse = function(input, handler, options) {
+  return binding.parse(input, handler, options);
+};
 
-  binding.parse(input, handler);
+// Create a function that turns a character index into a full mark.
+//
+//     var locate = yaml.stream.createLocator(input);
+//     var mark = locate(event.start);  // { index: ..., line: ..., column: ... }
+//
+// Indices count characters the way LibYAML does, ie. surrogate pairs count as one, and a leading
+// BOM is not included. The table of line starts is only built on the first call.
+//
+// One caveat: where the input does not end in a line break, LibYAML places the `streamEnd`
+// event on a line of its own, but the locator reports the end of the last line instead.
+YAML.stream.createLocator = function(input) {
+  var lineStarts = null;
+
+  var buildLineStarts = function() {
+    var length = input.length,
+        index = 0;
+    lineStarts = [0];
+    for (var i = (input.charCodeAt(0) === 0xFEFF) ? 1 : 0; i < length; i++, index++) {
+      var c = input.charCodeAt(i);
+      if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length) {
+        c = input.charCodeAt(i + 1);
+        if (c >= 0xDC00 && c <= 0xDFFF)
+          i++;
+      }
+      else if (c === 0x0D) {
+        if (input.charCodeAt(i + 1) === 0x0A) {
+          i++;
+          index++;
+        }
+        lineStarts.push(index + 1);
+      }
+      else if (c === 0x0A || c === 0x85 || c === 0x2028 || c === 0x2029) {
+        lineStarts.push(index + 1);
+      }
+    }
+  };
+
+  return function(index) {
+    if (lineStarts === null)
+      buildLineStarts();
+
+    // Binary search for the last line starting at or before `index`.
+    var low = 0, high = lineStarts.length - 1;
+    while (low < high) {
+      var mid = (low + high + 1) >> 1;
+      if (lineStarts[mid] <= index)
+        low = mid;
+      else
+        high = mid - 1;
+    }
+
+    return { index: index, line: low, column: index - lineStarts[low] };
+  };
 };
 
 // Create a YAML data stream from raw events.
@@ -92,6 +154,11 @@ YAMLStreamEmitter.prototype.scalar = function(value) {
   this.emitter_.event({ type: 'scalar', value: value });
 };
 
+// Emit a Buffer or Uint8Array as a `!!binary` scalar. The data is base64-encoded natively.
+YAMLStreamEmitter.prototype.binary = function(data) {
+  this.emitter_.event({ type: 'scalar', value: data });
+};
+
 YAML.stream.createEmitter = function(handler) {
   var result = new YAMLStreamEmitter();
   if (handler) result.on('data', handler);
@@ -103,242 +170,560 @@ YAML.stream.createEmitter = function(handler) {
 // ----- YAML reading functions -----
 //
 
-// Most of these were derived from: http://yaml.org/type/
-// Also borrows from tenderlove's `Psych::ScalarScanner`. (MIT-licensed)
-var definitelyNonNumericRe = /^[a-z~]/i,
-    definitelyNonBooleanRe = /^[^ytonf~]/i,
-    canParseIntRe   = /^[-+]?(0x[0-9a-fA-F_]+|[\d_]+)$/,
-    canParseFloatRe = /^[-+]?(\d[\d_]*)?\.[\d_]*(e[-+]\d+)?$/i,
-    octalRe  = /^[-+]?0\d/,
-    nullRe   = /^(~|null)$/i,
-    trueRe   = /^(y|yes|true|on)$/i,
-    falseRe  = /^(n|no|false|off)$/i,
-    posInfRe = /^\+?\.inf$/i,
-    negInfRe = /^-\.inf$/i,
-    nanRe    = /^\.nan$/i,
-    binRe    = /^([-+])?0b([01_]+)$/,
-    timeRe   = /^([-+]?)([0-9][\d_]*(?::[0-5]?\d)+(?:\.[\d_]*)?)$/,
-    dateRe   = /^\d{4}-\d\d?-\d\d?$/,
-    timestampRe = /^(\d{4}-\d\d?-\d\d?(?:[Tt]|\s+)\d\d?:\d\d:\d\d(?:\.\d*)?)(?:\s*(Z|[-+]\d\d?(?::\d\d)?))?$/,
-    underscoresRe = /_/g;
-
-// Tiny helper to pad a string.
-var pad = function(s, num, ch) {
-  while (s.length < num) s = ch + s;
-  return s;
-};
-
-// Helper function that converts a string scalar to its actual type.
-var parseScalar = function(v) {
-  if (!v) return null;
-
-  // Simple keywords.
-  if (definitelyNonNumericRe.test(v)) {
-    if (v.length > 5 || definitelyNonBooleanRe.test(v)) return v;
-    if (nullRe.test(v)) return null;
-    if (trueRe.test(v)) return true;
-    if (falseRe.test(v)) return false;
-    return v;
+// The `load` function reads all documents from the given string input. The return value is an
+// array of documents found represented as plain JavaScript objects, arrays and primitives.
+//
+// Documents are built natively. Scalars are resolved to nulls, booleans, numbers, dates and
+// strings following http://yaml.org/type/, or according to their standard tag, eg. `!!str`.
+// Values of tagged nodes are then passed through the matching function in `tagHandlers`, if
+// any. Aliases refer to the same value as their anchor.
+//
+// `options` may contain:
+//
+//  - `typedArrays`: if true, sequences of plain numbers become an `Int32Array` when all of them
+//    are 32-bit integers, or a `Float64Array` otherwise.
+//  - `columnar`: if true, sequences of mappings that all have the same keys, in the same order,
+//    and only scalar values, become an object with an array of values for each key. Columns of
+//    plain numbers are typed arrays, as above.
+//  - `maps`: if true, mappings become `Map` instances, which keep keys that are not strings as
+//    is. If a number, only mappings with at least that many pairs do. Needs a V8 with `Map`.
+//  - `uniqueKeys`: if true, a mapping with the same scalar key twice is an error. The error has
+//    the marks of both keys, as `context` and `problem`.
+//  - `dedupe`: if true, identical sequences and mappings share a single frozen value, as long as
+//    they contain only strings, numbers, booleans and nulls, without anchors or tag handlers.
+YAML.parse = function(input, tagHandlers, options) {
+  return binding.load(input, loadOptions(tagHandlers, options));
+};
+
+// Asynchronous version of `parse`. The input is parsed on the thread pool, so that several inputs
+// can be parsed at once, on all cores. Only the documents are built on the main thread.
+//
+//     YAML.parseAsync(input, function(error, documents) { /* ... */ });
+//
+// With the `pipeline` option, the input is instead parsed on a thread of its own, while the main
+// thread builds documents from what is parsed so far, in slices of at most `sliceMs`
+// milliseconds (5 by default). This overlaps parsing and building for large inputs, and keeps
+// the event loop responsive. Sequences that may become typed arrays or columns, and mappings that
+// may become a `Map` by their number of pairs, are built once they are parsed in full. With
+// `dedupe`, building waits for the whole input.
+//
+// A parse can be stopped early with the `signal` and `deadline` options, see `cancelOptions`.
+YAML.parseAsync = function(input, tagHandlers, options, callback) {
+  if (typeof tagHandlers === 'function') {
+    callback = tagHandlers;
+    tagHandlers = {};
+    options = {};
   }
-  if (posInfRe.test(v)) return  1/0;
-  if (negInfRe.test(v)) return -1/0;
-  if (nanRe.test(v))    return  0/0;
-
-  // JavaScript's `parseInt` does not support binary numbers.
-  var m = binRe.exec(v);
-  if (m) {
-    var s = m[2],
-        length = s.length,
-        result = 0;
-    for (var i = 0; i < length; i++) {
-      if (s[i] == '_')
-        continue;
-      result *= 2;
-      if (s[i] == '1')
-        result++;
+  else if (typeof options === 'function') {
+    callback = options;
+    options = {};
+  }
+  if (typeof options !== 'object' || options === null)
+    options = {};
+
+  var bindingOptions = loadOptions(tagHandlers, options);
+  var unlisten = cancelOptions(bindingOptions, options);
+  var done = function(err, documents) {
+    unlisten();
+    callback(err, documents);
+  };
+  try {
+    if (options.pipeline) {
+      if (options.sliceMs !== undefined)
+        bindingOptions.sliceMs = options.sliceMs;
+      binding.loadPipelined(input, bindingOptions, done);
+    }
+    else {
+      binding.loadAsync(input, bindingOptions, done);
     }
-    if (m[1] == '-')
-      result *= -1;
-    return result;
   }
+  catch (err) {
+    unlisten();
+    throw err;
+  }
+};
 
-  // JavaScript's datetime parsing is subtly different from YAML's.
-  var m = timestampRe.exec(v);
-  if (m) {
-    var dateTimePart = m[1].replace('t', 'T'),
-        offset = 0;
-    if (m[2] && m[2] !== 'Z') {
-      var parts = m[2].split(':');
-      offset = parseInt(parts[0], 10) * 100;
-      if (parts.length == 2)
-        offset += parseInt(parts[1], 10);
-    }
-    if (offset >= 0)
-      offset = "+" + pad(String(offset), 4, '0');
-    else
-      offset = "-" + pad(String(Math.abs(offset)), 4, '0');
-    return new Date(dateTimePart + offset);
+// Add the options to stop a parse early to those for the binding:
+//
+//  - `signal`: an `AbortSignal`, or any object with an `aborted` flag and an `abort` event. Once
+//    aborted, the parse fails with an error that has the code `ABORT_ERR`.
+//  - `deadline`: a `Date`, or a time in milliseconds as from `Date.now()`. Past it, the parse
+//    fails with an error that has the code `ETIMEDOUT`.
+//
+// The signal sets a flag that native code checks every few hundred events, as does the deadline,
+// and the parser is torn down. Returns a function that stops listening to the signal.
+var cancelOptions = function(bindingOptions, options) {
+  if (options.deadline !== undefined && options.deadline !== null)
+    bindingOptions.timeoutMs = Math.max(0, +options.deadline - Date.now());
+
+  var signal = options.signal;
+  if (!signal)
+    return function() {};
+
+  var flag = bindingOptions.abortFlag = new Buffer(1);
+  flag[0] = signal.aborted ? 1 : 0;
+  var onAbort = function() {
+    flag[0] = 1;
+  };
+  if (typeof signal.addEventListener === 'function') {
+    signal.addEventListener('abort', onAbort);
+    return function() {
+      signal.removeEventListener('abort', onAbort);
+    };
+  }
+  if (typeof signal.on === 'function') {
+    signal.on('abort', onAbort);
+    return function() {
+      signal.removeListener('abort', onAbort);
+    };
   }
-  if (dateRe.test(v))
-    return new Date(v + "T00:00:00Z");
+  return function() {};
+};
+
+// Run a function on a later turn of the event loop, after I/O.
+var defer = typeof setImmediate === 'function' ? setImmediate : function(fn) {
+  setTimeout(fn, 0);
+};
 
-  // Regular numbers.
-  if (canParseIntRe.test(v)) {
-    v = v.replace(underscoresRe, '');
-    return parseInt(v, octalRe.test(v) ? 8 : 0);
+// Parse on the main thread, in slices, for where threads are not an option. Each slice runs the
+// parser and builder for about `budgetMs` milliseconds (5 by default), then yields to the event
+// loop, so that large inputs don't block it for long. Parser and builder state is kept between
+// slices. Without a callback, returns a Promise, where available.
+//
+//     YAML.parseIncremental(input, {}, { budgetMs: 2 }, function(error, documents) { /* ... */ });
+//
+// Other options are those of `parse`, and `signal` and `deadline` to stop early, as with
+// `parseAsync`. Sequences that may become typed arrays or columns, and mappings that may become
+// a `Map` by their number of pairs, are built in one go once they are parsed in full. With
+// `dedupe`, all documents are built in one go at the end.
+YAML.parseIncremental = function(input, tagHandlers, options, callback) {
+  if (typeof tagHandlers === 'function') {
+    callback = tagHandlers;
+    tagHandlers = {};
+    options = {};
   }
-  if (canParseFloatRe.test(v)) {
-    v = v.replace(underscoresRe, '');
-    return parseFloat(v);
+  else if (typeof options === 'function') {
+    callback = options;
+    options = {};
   }
+  if (typeof options !== 'object' || options === null)
+    options = {};
+
+  if (!callback && typeof Promise === 'function') {
+    return new Promise(function(resolve, reject) {
+      YAML.parseIncremental(input, tagHandlers, options, function(err, documents) {
+        if (err)
+          reject(err);
+        else
+          resolve(documents);
+      });
+    });
+  }
+  if (typeof callback !== 'function')
+    throw new TypeError('Callback must be a function.');
 
-  // Times.
-  var m = timeRe.exec(v);
-  if (m) {
-    var parts = m[2].split(':'),
-        length = parts.length,
-        result = 0;
-    for (var i = 0; i < length; i++) {
-      result *= 60;
-      if (length == i + 1)
-        result += parseFloat(parts[i]);
-      else
-        result += parseInt(parts[i], 10);
-    }
-    if (m[1] == '-')
-      result *= -1;
-    return result;
+  var budget = options.budgetMs === undefined ? 5 : options.budgetMs;
+  var bindingOptions = loadOptions(tagHandlers, options);
+  var unlisten = cancelOptions(bindingOptions, options);
+  var loader;
+  try {
+    loader = new binding.Loader(input, bindingOptions);
   }
+  catch (err) {
+    unlisten();
+    throw err;
+  }
+  var step = function() {
+    // Signals without events are only seen between steps.
+    if (options.signal && options.signal.aborted)
+      bindingOptions.abortFlag[0] = 1;
 
-  return v;
+    var documents;
+    try {
+      documents = loader.step(budget);
+    }
+    catch (err) {
+      unlisten();
+      return callback(err);
+    }
+    if (documents) {
+      unlisten();
+      callback(null, documents);
+    }
+    else {
+      defer(step);
+    }
+  };
+  defer(step);
 };
 
-
-// The `load` function reads all documents from the given string input. The return value is an
-// array of documents found represented as plain JavaScript objects, arrays and primitives.
-YAML.parse = function(input, tagHandlers) {
-  if (typeof tagHandlers !== 'object')
+// Build the options for `binding.load` from those of `parse`.
+var loadOptions = function(tagHandlers, options) {
+  if (typeof tagHandlers !== 'object' || tagHandlers === null)
     tagHandlers = {};
-
-  var parserHandler, handlerStack = [];
-
-  // Capture all values between two parser events. Because we can nest in YAML, we need a stack of
-  // these value handlers, and we need to ensure we can deal with `until` blocks that are nested
-  // for the same kinds of events (ie. restore the old event handler afterwards).
-  var until = function(method, valueHandler) {
-    var oldMethod = parserHandler[method];
-    handlerStack.unshift(valueHandler);
-    parserHandler[method] = function(e) {
-      parserHandler[method] = oldMethod;
-      var oldHandler = handlerStack.shift();
-      oldHandler.after();
-    };
+  if (typeof options !== 'object' || options === null)
+    options = {};
+
+  return {
+    tagHandlers: tagHandlers,
+    typedArrays: !!options.typedArrays,
+    columnar: !!options.columnar,
+    maps: options.maps === true ? 0 : options.maps,
+    uniqueKeys: !!options.uniqueKeys,
+    dedupe: !!options.dedupe
   };
+};
 
-  // Dispatch a value. At this point, the value is a JavaScript primitive, ie. sequences are
-  // `Array`s, numeric scalars are `Number`s, etc. If a tag was specified, the tag handler
-  // function is asked to post process the value. The value is then sent to the current value
-  // handler in the stack.
-  var dispatch = function(e, value) {
-    if (e.tag !== null) {
-      var tagHandler = tagHandlers[e.tag];
-      // FIXME: Deal with standard tags
-      if (tagHandler)
-        value = tagHandler(value);
-    }
-    handlerStack[0].handle(value);
+// Read all documents from the given string input, like `parse`, but only build values as they
+// are accessed. The input is parsed up front into a compact native form, and sequences and
+// mappings are returned as read-only views of it, which create their children on first access.
+// Repeated access returns the same child.
+//
+// Views enumerate like regular objects and arrays, but sequences are not real arrays, so
+// `Array.isArray` fails on them and they have no array methods. Only scalar keys of mappings
+// are available. Tag handlers are not supported, and each alias of a collection is a view of
+// its own.
+YAML.parseLazy = function(input) {
+  return binding.loadLazy(input);
+};
+
+// A cache of parsed files, used by `readFile`, `readFileSync` and the `require` hook when
+// enabled. Cached documents are deep-frozen, because they are shared by all readers of a file.
+// Buffers, typed arrays, dates and `Map` contents remain modifiable, and should be treated as
+// read-only all the same.
+//
+//     YAML.cache.enabled = true;
+//     var documents = YAML.readFileSync('myfile.yml');  // A miss, parses the file.
+//     documents = YAML.readFileSync('myfile.yml');      // A hit, no I/O besides a `stat`.
+//
+// Files are keyed by their path, size, modification time and inode number. With `keyBy` set to
+// `'content'`, they are instead keyed by a hash of their content, which also catches changes
+// within the resolution of the modification time, but always reads the file. Reads with tag
+// handlers are never cached.
+//
+// Least recently used files are evicted once the total size of cached files exceeds `maxSize`
+// bytes of input. The `hits` and `misses` counters are never reset by the cache itself.
+var ParseCache = function() {
+  this.enabled = false;
+  this.keyBy = 'stat';
+  this.maxSize = 64 * 1024 * 1024;
+
+  this.hits = 0;
+  this.misses = 0;
+  this.size = 0;
+
+  // Entries by key, and a list of them from most to least recently used.
+  this.entries_ = {};
+  this.newest_ = null;
+  this.oldest_ = null;
+};
+
+// Remove all files from the cache.
+ParseCache.prototype.clear = function() {
+  this.entries_ = {};
+  this.newest_ = this.oldest_ = null;
+  this.size = 0;
+};
+
+ParseCache.prototype.unlink_ = function(entry) {
+  if (entry.newer) entry.newer.older = entry.older;
+  else this.newest_ = entry.older;
+  if (entry.older) entry.older.newer = entry.newer;
+  else this.oldest_ = entry.newer;
+};
+
+ParseCache.prototype.get_ = function(key) {
+  var entry = this.entries_[key];
+  if (!entry) {
+    this.misses++;
+    return null;
+  }
+
+  this.hits++;
+  if (entry !== this.newest_) {
+    this.unlink_(entry);
+    entry.newer = null;
+    entry.older = this.newest_;
+    this.newest_.newer = entry;
+    this.newest_ = entry;
+  }
+  return entry.documents;
+};
+
+ParseCache.prototype.set_ = function(key, documents, size) {
+  var entry = this.entries_[key];
+  if (entry) {
+    this.unlink_(entry);
+    this.size -= entry.size;
+  }
+  if (size > this.maxSize) {
+    delete this.entries_[key];
+    return;
+  }
+
+  entry = this.entries_[key] = {
+    key: key, documents: documents, size: size,
+    newer: null, older: this.newest_
   };
+  if (this.newest_) this.newest_.newer = entry;
+  else this.oldest_ = entry;
+  this.newest_ = entry;
+  this.size += size;
+
+  while (this.size > this.maxSize) {
+    var oldest = this.oldest_;
+    this.unlink_(oldest);
+    delete this.entries_[oldest.key];
+    this.size -= oldest.size;
+  }
+};
 
-  // Call into the parser and build the documents.
-  var documents = [];
-  YAML.stream.parse(input, parserHandler = {
-    onDocumentEnd: null,
-    onDocumentStart: function(e) {
-      var document;
-      until('onDocumentEnd', {
-        handle: function(value) {
-          document = value;
-        },
-        after: function() {
-          documents.push(document);
-        }
-      });
-    },
-
-    onAlias: function(e) {
-      // FIXME
-    },
-
-    onScalar: function(e) {
-      dispatch(e, parseScalar(e.value));
-    },
-
-    onSequenceEnd: null,
-    onSequenceStart: function(e) {
-      var sequence = [];
-      until('onSequenceEnd', {
-        handle: function(value) {
-          sequence.push(value);
-        },
-        after: function() {
-          dispatch(e, sequence);
-        }
-      });
-    },
-
-    onMappingEnd: null,
-    onMappingStart: function(e) {
-      var mapping = {}, key = undefined;
-      until('onMappingEnd', {
-        handle: function(value) {
-          if (key === undefined) {
-            key = value;
-          }
-          else {
-            mapping[key] = value;
-            key = undefined;
-          }
-        },
-        after: function() {
-          dispatch(e, mapping);
-        }
-      });
-    }
-  });
+YAML.cache = new ParseCache();
+
+// Freeze a parsed value and everything it contains.
+var deepFreeze = function(value) {
+  if (typeof value !== 'object' || value === null || Object.isFrozen(value))
+    return value;
+  // V8 can't freeze array buffer views with elements.
+  if (Buffer.isBuffer(value) || value instanceof Uint8Array ||
+      value instanceof Int32Array || value instanceof Float64Array)
+    return value;
+
+  Object.freeze(value);
+  var keys = Object.keys(value), length = keys.length;
+  for (var i = 0; i < length; i++)
+    deepFreeze(value[keys[i]]);
+  return value;
+};
+
+// Check whether a read can use the cache.
+var isCacheable = function(tagHandlers) {
+  if (!YAML.cache.enabled)
+    return false;
+  if (typeof tagHandlers !== 'object' || tagHandlers === null)
+    return true;
+  return Object.keys(tagHandlers).length === 0;
+};
+
+// Build a cache key for a file, from a `stat` result or the content of the file. Options that
+// change the result are part of the key.
+var cacheKey = function(filename, stat, data, options) {
+  if (typeof options !== 'object' || options === null)
+    options = {};
+
+  var key;
+  if (stat)
+    key = [path.resolve(filename), stat.size, stat.mtime.getTime(), stat.ino].join('\0');
+  else
+    key = crypto.createHash('sha1').update(data, 'utf8').digest('hex');
+
+  return key + '\0' + [
+    !!options.typedArrays, !!options.columnar, options.maps,
+    !!options.uniqueKeys, !!options.dedupe
+  ].join(',');
+};
+
+// A cache of compiled files on disk, used by `readFileSync` and the `require` hook when enabled.
+// Compiled files hold the parsed and resolved content of YAML files, and load much faster than
+// parsing again.
+//
+//     YAML.diskCache.enabled = true;
+//     YAML.diskCache.directory = '/var/cache/myapp';  // Optional.
+//
+// Compiled files are written next to YAML files, with a `c` appended to their name, or to
+// `directory` if set, named after a hash of the path of the YAML file. They start with a hash of
+// the content they were compiled from, and are replaced when the content changes. The format is
+// specific to the machine and the build of this module, and files that don't match are replaced
+// as well. Failures to write compiled files are ignored.
+YAML.diskCache = {
+  enabled: false,
+  directory: null
+};
+
+// Get the path of the compiled file for a YAML file.
+var compiledPath = function(filename) {
+  var directory = YAML.diskCache.directory;
+  if (!directory)
+    return filename + 'c';
+  var hash = crypto.createHash('sha1').update(path.resolve(filename), 'utf8').digest('hex');
+  return path.join(directory, hash + '.yamlc');
+};
+
+// Write a file atomically, so that concurrent readers never see a partial file.
+var writeFileAtomicSync = function(file, data) {
+  var temporary = file + '.' + process.pid;
+  try {
+    fs.writeFileSync(temporary, data);
+    fs.renameSync(temporary, file);
+  }
+  catch (err) {
+    try { fs.unlinkSync(temporary); } catch (err2) {}
+    throw err;
+  }
+};
+
+// Parse the content of a file, through the disk cache if it is enabled.
+var parseFileSync = function(filename, data, tagHandlers, options) {
+  if (!YAML.diskCache.enabled)
+    return YAML.parse(data, tagHandlers, options);
 
+  options = loadOptions(tagHandlers, options);
+  var digest = crypto.createHash('sha1')
+    .update(options.uniqueKeys ? 'unique\n' : '\n', 'utf8')
+    .update(data, 'utf8')
+    .digest('hex');
+
+  var file = compiledPath(filename), compiled = null;
+  try {
+    compiled = fs.readFileSync(file);
+  }
+  catch (err) {}
+  if (compiled && compiled.toString('ascii', 0, digest.length) === digest) {
+    var documents = binding.loadCompiled(compiled.slice(digest.length), options);
+    if (documents)
+      return documents;
+  }
+
+  compiled = binding.compile(data, { uniqueKeys: options.uniqueKeys });
+  try {
+    writeFileAtomicSync(file, Buffer.concat([new Buffer(digest, 'ascii'), compiled]));
+  }
+  catch (err) {}
+  return binding.loadCompiled(compiled, options);
+};
+
+// Freeze parsed documents and store them in the cache.
+var cacheDocuments = function(key, documents, data) {
+  deepFreeze(documents);
+  YAML.cache.set_(key, documents, Buffer.byteLength(data, 'utf8'));
   return documents;
 };
 
-// Helper for quickly reading in a file.
-YAML.readFile = function(filename, tagHandlers, callback) {
+// Parse and resolve YAML input into a compact, self-contained Buffer, for `readTape`. `options`
+// may contain `uniqueKeys`. The format is specific to the machine and the build of this module.
+YAML.compile = function(input, options) {
+  if (typeof options !== 'object' || options === null)
+    options = {};
+
+  return binding.compile(input, { uniqueKeys: !!options.uniqueKeys });
+};
+
+// Read the documents in a Buffer from `compile`. Documents are read-only views, as returned by
+// `parseLazy`, that read the Buffer in place, so a tape can be parsed once and read by any number
+// of readers without copies. The Buffer must not be modified while it is being read.
+YAML.readTape = function(buffer) {
+  return binding.readTape(buffer);
+};
+
+// Write a snapshot of YAML input to a file, for `openSnapshot`. The input is parsed and resolved
+// as with `parse`, and `options` may contain `uniqueKeys`. Snapshots are specific to the machine
+// and the build of this module.
+YAML.writeSnapshotSync = function(filename, input, options) {
+  writeFileAtomicSync(filename, YAML.compile(input, options));
+};
+
+// Open a snapshot written by `writeSnapshotSync`. Documents are read-only views, as returned by
+// `parseLazy`, but read the file in place: it is mapped into memory rather than loaded, so
+// processes that open the same snapshot share one copy of it through the page cache.
+//
+// A snapshot must not be modified while it is open. `writeSnapshotSync` replaces the file
+// instead, which leaves views of the old snapshot intact.
+YAML.openSnapshot = function(filename) {
+  return binding.openSnapshot(filename);
+};
+
+// Helper for quickly reading in a file. The file is parsed on the thread pool.
+YAML.readFile = function(filename, tagHandlers, options, callback) {
   if (typeof tagHandlers === 'function') {
     callback = tagHandlers;
     tagHandlers = {};
+    options = {};
+  }
+  else if (typeof options === 'function') {
+    callback = options;
+    options = {};
   }
 
-  fs.readFile(filename, 'utf-8', function(err, data) {
+  var cacheable = isCacheable(tagHandlers),
+      byContent = cacheable && YAML.cache.keyBy === 'content';
+
+  // Parse file content, and store the documents in the cache if there is a key.
+  var parse = function(data, key) {
+    YAML.parseAsync(data, tagHandlers, options, function(err, documents) {
+      if (err) {
+        callback(err, null);
+        return;
+      }
+
+      if (key)
+        documents = cacheDocuments(key, documents, data);
+      callback(null, documents);
+    });
+  };
+
+  var read = function(key) {
+    fs.readFile(filename, 'utf-8', function(err, data) {
+      if (err) {
+        callback(err, null);
+        return;
+      }
+
+      if (byContent) {
+        key = cacheKey(filename, null, data, options);
+        var documents = YAML.cache.get_(key);
+        if (documents) {
+          callback(null, documents);
+          return;
+        }
+      }
+
+      parse(data, key);
+    });
+  };
+
+  if (!cacheable || byContent) {
+    read(null);
+    return;
+  }
+
+  fs.stat(filename, function(err, stat) {
     if (err) {
       callback(err, null);
       return;
     }
 
-    var documents;
-    try {
-      documents = YAML.parse(data, tagHandlers);
-    }
-    catch (err) {
-      callback(err, null);
+    var key = cacheKey(filename, stat, null, options);
+    var documents = YAML.cache.get_(key);
+    if (documents) {
+      callback(null, documents);
       return;
     }
 
-    callback(null, documents);
+    read(key);
   });
 };
 
 // Synchronous version of loadFile.
-YAML.readFileSync = function(filename, tagHandlers) {
-  var data = fs.readFileSync(filename, 'utf-8');
-  return YAML.parse(data, tagHandlers);
+YAML.readFileSync = function(filename, tagHandlers, options) {
+  if (!isCacheable(tagHandlers))
+    return parseFileSync(filename, fs.readFileSync(filename, 'utf-8'), tagHandlers, options);
+
+  var key, data, documents;
+  if (YAML.cache.keyBy === 'content') {
+    data = fs.readFileSync(filename, 'utf-8');
+    key = cacheKey(filename, null, data, options);
+  }
+  else {
+    key = cacheKey(filename, fs.statSync(filename), null, options);
+  }
+
+  documents = YAML.cache.get_(key);
+  if (documents)
+    return documents;
+
+  if (data === undefined)
+    data = fs.readFileSync(filename, 'utf-8');
+  return cacheDocuments(key, parseFileSync(filename, data, {}, options), data);
 };
 
 // Allow direct requiring of YAML files.
@@ -365,6 +750,9 @@ var serialize = function(emitter, item) {
       else if (item instanceof Date) {
         emitter.scalar(item.toISOString());
       }
+      else if (Buffer.isBuffer(item) || item instanceof Uint8Array) {
+        emitter.binary(item);
+      }
       else if (item.length) {
         emitter.sequence(function() {
           var length = item.length;
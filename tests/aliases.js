@@ -0,0 +1,63 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var testutil = require('../testutil');
+var YAML = require('../');
+
+testutil.simple('aliases', [
+  {
+    base: { name: 'base', items: [1, 2] },
+    copy: { name: 'base', items: [1, 2] },
+    more: [1, 2]
+  }
+]);
+
+test('aliases share their value', function(t) {
+  t.plan(2);
+
+  var doc = YAML.readFileSync(testutil.inputPath('aliases'))[0];
+  t.equal(doc.copy, doc.base);
+  t.equal(doc.more, doc.base.items);
+});
+
+test('undefined aliases', function(t) {
+  t.plan(1);
+
+  t.throws(function() {
+    YAML.parse('foo: *bar');
+  }, {
+    name: 'Error',
+    message: 'found undefined alias, on line 0'
+  });
+});
+
+test('aliases are scoped to their document', function(t) {
+  t.plan(1);
+
+  t.throws(function() {
+    YAML.parse('--- &a x\n--- *a');
+  }, {
+    name: 'Error',
+    message: 'found undefined alias, on line 1'
+  });
+});
+
+test('tag handlers', function(t) {
+  t.plan(2);
+
+  var calls = 0;
+  var result = YAML.parse('[!double 2, !double 3, !upper foo, !none bar]', {
+    '!double': function(value) {
+      calls++;
+      return value * 2;
+    },
+    '!upper': function(value) {
+      return value.toUpperCase();
+    }
+  });
+
+  t.equal(calls, 2);
+  t.ok(_.isEqual(result, [[4, 6, 'FOO', 'bar']]), 'should be equal', {
+    found: result,
+    wanted: [[4, 6, 'FOO', 'bar']]
+  });
+});
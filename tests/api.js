@@ -26,6 +26,128 @@ test('basic stream parse tests', function(t) {
   });
 });
 
+test('index marks and locator', function(t) {
+  var input = 'foo:\n  - bar\r\n  - "\u00e9\ud83d\ude00"\n  - { baz: qux }\n';
+
+  var full = [];
+  YAML.stream.parse(input, function(ev) {
+    full.push(ev);
+  });
+
+  var indexed = [];
+  YAML.stream.parse(input, function(ev) {
+    indexed.push(ev);
+  }, { marks: 'index' });
+
+  t.plan(full.length * 4 + 1);
+  t.equal(indexed.length, full.length);
+
+  var locate = YAML.stream.createLocator(input);
+  for (var i = 0; i < full.length; i++) {
+    t.equal(typeof(indexed[i].start), 'number');
+    t.equal(typeof(indexed[i].end), 'number');
+    t.ok(_.isEqual(locate(indexed[i].start), full[i].start), 'start mark should match');
+    t.ok(_.isEqual(locate(indexed[i].end), full[i].end), 'end mark should match');
+  }
+});
+
+test('stream parse field selection', function(t) {
+  t.plan(4);
+
+  var events = [];
+  YAML.stream.parse('foo', function(ev) {
+    events.push(ev);
+  }, { fields: ['type', 'value'] });
+
+  t.ok(_.isEqual(Object.keys(events[0]).sort(), ['type']), 'streamStart has only a type');
+  t.ok(_.isEqual(events[2], { type: 'scalar', value: 'foo' }), 'scalar has a type and value');
+
+  var values = [];
+  YAML.stream.parse('[a, b]', {
+    onScalar: function(ev) {
+      values.push(ev.value);
+    }
+  }, { fields: ['value'] });
+  t.ok(_.isEqual(values, ['a', 'b']), 'handler methods still receive their events');
+
+  t.throws(function() {
+    YAML.stream.parse('foo', function() {}, { fields: ['bogus'] });
+  }, {
+    name: 'TypeError',
+    message: 'Unknown event field: bogus'
+  });
+});
+
+test('flyweight stream parse', function(t) {
+  var input = '- foo\n- &a { bar: [1, 2] }\n- *a\n';
+
+  var copy = function(ev) {
+    var result = {};
+    for (var p in ev) {
+      if (ev[p] !== null && ev[p] !== undefined)
+        result[p] = (typeof(ev[p]) === 'object') ? _.clone(ev[p]) : ev[p];
+    }
+    return result;
+  };
+
+  var expected = [];
+  YAML.stream.parse(input, function(ev) {
+    expected.push(copy(ev));
+  });
+
+  var found = [], first = null, same = true;
+  YAML.stream.parse(input, function(ev) {
+    if (first === null)
+      first = ev;
+    else if (ev !== first)
+      same = false;
+    found.push(copy(ev));
+  }, { flyweight: true });
+
+  t.plan(2);
+  t.ok(same, 'every event should be the same object');
+  t.ok(_.isEqual(found, expected), 'should be equal', {
+    found: found,
+    wanted: expected
+  });
+});
+
+test('stream parse early exit', function(t) {
+  t.plan(5);
+
+  var values = [];
+  var completed = YAML.stream.parse('[a, b, c]', {
+    onScalar: function(ev) {
+      values.push(ev.value);
+      if (ev.value === 'b')
+        return false;
+    }
+  });
+  t.equal(completed, false);
+  t.ok(_.isEqual(values, ['a', 'b']), 'should stop after the handler returns false');
+
+  t.equal(YAML.stream.parse('[a, b, c]', function() {}), true);
+
+  t.throws(function() {
+    YAML.stream.parse('[a, b, c]', function(ev) {
+      if (ev.type === 'scalar')
+        throw new Error('handler failure');
+    });
+  }, {
+    name: 'Error',
+    message: 'handler failure'
+  });
+
+  var context = null;
+  var handler = {
+    onStreamStart: function() {
+      context = this;
+    }
+  };
+  YAML.stream.parse('foo', handler);
+  t.equal(context, handler, 'methods should be called on the handler');
+});
+
 test('basic stream emit tests', function(t) {
   t.plan(2);
 
@@ -0,0 +1,30 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+test('async parse', function(t) {
+  var inputs = ['foo: [1, 2]', '- a\n- b', '--- 1\n--- !!binary aGVsbG8=', 'x: 2001-12-14'];
+  t.plan(inputs.length + 3);
+
+  inputs.forEach(function(input) {
+    YAML.parseAsync(input, function(error, documents) {
+      t.ok(_.isEqual(documents, YAML.parse(input)), 'should match a sync parse');
+    });
+  });
+
+  YAML.parseAsync('foo: [', function(error, documents) {
+    t.ok(error instanceof Error, 'should pass parse errors');
+  });
+
+  YAML.parseAsync('!upper foo', {
+    '!upper': function(value) { return value.toUpperCase(); }
+  }, function(error, documents) {
+    t.ok(_.isEqual(documents, ['FOO']), 'should call tag handlers');
+  });
+
+  YAML.parseAsync('!fail foo', {
+    '!fail': function() { throw new Error('handler failure'); }
+  }, function(error, documents) {
+    t.equal(error.message, 'handler failure', 'should pass handler errors');
+  });
+});
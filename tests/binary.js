@@ -0,0 +1,48 @@
+var test = require('tap').test;
+var testutil = require('../testutil');
+var YAML = require('../');
+
+var bytes = function(length) {
+  var buffer = new Buffer(length);
+  for (var i = 0; i < length; i++)
+    buffer[i] = i & 0xFF;
+  return buffer;
+};
+
+test('binary scalars', function(t) {
+  t.plan(5);
+
+  var doc = YAML.readFileSync(testutil.inputPath('binary'))[0];
+  t.ok(Buffer.isBuffer(doc.hello), 'should be a Buffer');
+  t.equal(doc.hello.toString(), 'hello');
+  t.equal(doc.wrapped.toString('hex'), bytes(81).toString('hex'));
+  t.equal(doc.unpadded.toString(), 'hi');
+  t.equal(doc.empty.length, 0);
+});
+
+test('invalid binary scalars', function(t) {
+  t.plan(1);
+
+  t.throws(function() {
+    YAML.parse('!!binary "not base64!"');
+  }, {
+    name: 'Error',
+    message: 'found a scalar that does not match its tag, on line 0'
+  });
+});
+
+test('binary round trip', function(t) {
+  var lengths = [0, 1, 2, 3, 56, 57, 58, 1000];
+  t.plan(lengths.length * 2 + 1);
+
+  lengths.forEach(function(length) {
+    var data = bytes(length);
+    var output = YAML.stringify(data);
+    var result = YAML.parse(output)[0];
+    t.ok(Buffer.isBuffer(result), 'should be a Buffer');
+    t.equal(result.toString('hex'), data.toString('hex'));
+  });
+
+  var array = new Uint8Array([104, 105]);
+  t.equal(YAML.parse(YAML.stringify({ data: array }))[0].data.toString(), 'hi');
+});
@@ -0,0 +1,41 @@
+var fs = require('fs');
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+test('parse cache', function(t) {
+  t.plan(8);
+
+  var file = '/tmp/yaml.node-cache-test.yml';
+  fs.writeFileSync(file, 'foo: [bar, { baz: 1 }]');
+
+  YAML.cache.enabled = true;
+  var hits = YAML.cache.hits, misses = YAML.cache.misses;
+
+  var first = YAML.readFileSync(file);
+  var second = YAML.readFileSync(file);
+  t.equal(first, second, 'should return the cached documents');
+  t.equal(YAML.cache.hits - hits, 1);
+  t.equal(YAML.cache.misses - misses, 1);
+  t.ok(Object.isFrozen(first[0].foo[1]), 'should deep-freeze documents');
+  t.notEqual(YAML.readFileSync(file, {}, { typedArrays: true }), first,
+      'should key on options');
+
+  fs.writeFileSync(file, 'foo: changed');
+  t.ok(_.isEqual(YAML.readFileSync(file), [{ foo: 'changed' }]), 'should see changes');
+
+  YAML.cache.keyBy = 'content';
+  var third = YAML.readFileSync(file);
+  t.equal(YAML.readFileSync(file), third);
+
+  YAML.cache.clear();
+  YAML.cache.maxSize = 4;
+  YAML.readFileSync(file);
+  t.equal(YAML.cache.size, 0, 'should not keep files over the size limit');
+
+  fs.unlinkSync(file);
+  YAML.cache.clear();
+  YAML.cache.enabled = false;
+  YAML.cache.keyBy = 'stat';
+  YAML.cache.maxSize = 64 * 1024 * 1024;
+});
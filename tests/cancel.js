@@ -0,0 +1,63 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var EventEmitter = require('events').EventEmitter;
+var YAML = require('../');
+
+// Large enough that parsing is still going when it is aborted.
+var big = '';
+for (var i = 0; i < 20000; i++)
+  big += 'item' + i + ': [1, 2.5, {name: n' + i + ', size: ' + i + '}]\n';
+
+var modes = {
+  'async': function(input, options, callback) {
+    YAML.parseAsync(input, {}, options, callback);
+  },
+  'pipelined': function(input, options, callback) {
+    YAML.parseAsync(input, {}, _.extend({ pipeline: true }, options), callback);
+  },
+  'incremental': function(input, options, callback) {
+    YAML.parseIncremental(input, {}, options, callback);
+  }
+};
+
+var signal = function() {
+  var signal = new EventEmitter();
+  signal.aborted = false;
+  signal.abort = function() {
+    signal.aborted = true;
+    signal.emit('abort');
+  };
+  return signal;
+};
+
+_.each(modes, function(parse, mode) {
+  test('cancel ' + mode + ' parse', function(t) {
+    t.plan(6);
+
+    var aborted = signal();
+    parse(big, { signal: aborted }, function(error, documents) {
+      t.equal(error && error.code, 'ABORT_ERR', 'should abort on the signal');
+      t.equal(aborted.listeners('abort').length, 0, 'should stop listening');
+    });
+    aborted.abort();
+
+    var early = signal();
+    early.abort();
+    parse('foo: bar', { signal: early }, function(error, documents) {
+      t.equal(error && error.code, 'ABORT_ERR', 'should abort on a signal aborted before');
+    });
+
+    parse(big, { deadline: Date.now() - 1 }, function(error, documents) {
+      t.equal(error && error.code, 'ETIMEDOUT', 'should stop at the deadline');
+    });
+
+    parse('foo: bar', { signal: signal(), deadline: new Date(Date.now() + 60000) },
+        function(error, documents) {
+      t.ok(_.isEqual(documents, [{ foo: 'bar' }]), 'should finish otherwise');
+    });
+
+    parse('foo: [', { signal: signal() }, function(error, documents) {
+      t.ok(error instanceof Error && !error.code, 'should still pass parse errors');
+    });
+  });
+});
@@ -0,0 +1,41 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+var toArray = function(array) {
+  return Array.prototype.slice.call(array);
+};
+
+test('columnar sequences', function(t) {
+  t.plan(6);
+
+  var doc = YAML.parse([
+    '- { id: 1, name: foo, score: 0.5 }',
+    '- { id: 2, name: bar, score: 1.5 }',
+    '- { id: 3, name: ~, score: 2 }'
+  ].join('\n'), {}, { columnar: true })[0];
+
+  t.ok(_.isEqual(_.keys(doc), ['id', 'name', 'score']), 'should have a column per key');
+  t.ok(doc.id instanceof Int32Array, 'should be an Int32Array');
+  t.ok(_.isEqual(toArray(doc.id), [1, 2, 3]), 'should be equal');
+  t.ok(_.isEqual(doc.name, ['foo', 'bar', null]), 'should be equal');
+  t.ok(doc.score instanceof Float64Array, 'should be a Float64Array');
+  t.ok(_.isEqual(toArray(doc.score), [0.5, 1.5, 2]), 'should be equal');
+});
+
+test('non-uniform sequences', function(t) {
+  var inputs = [
+    '[{ a: 1, b: 2 }, { b: 2, a: 1 }]',
+    '[{ a: 1 }, { a: 1, b: 2 }]',
+    '[{ a: 1 }, { a: [1] }]',
+    '[{ a: 1 }, 2]',
+    '[{ a: 1, a: 2 }]',
+    '[&x { a: 1 }]'
+  ];
+  t.plan(inputs.length);
+
+  inputs.forEach(function(input) {
+    var result = YAML.parse(input, {}, { columnar: true })[0];
+    t.ok(Array.isArray(result), 'should be an array');
+  });
+});
@@ -0,0 +1,24 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+test('shared subtrees', function(t) {
+  t.plan(7);
+
+  var input = [
+    '- { name: probe, port: 80, tags: [a, b] }',
+    '- { name: probe, port: 80, tags: [a, b] }',
+    '- { name: probe, port: 81, tags: [a, b] }',
+    '- { at: 2001-12-14, tags: [a, b] }',
+    '- { at: 2001-12-14, tags: [a, b] }'
+  ].join('\n');
+  var doc = YAML.parse(input, {}, { dedupe: true })[0];
+
+  t.ok(_.isEqual(doc, YAML.parse(input)[0]), 'should be equal to a regular parse');
+  t.equal(doc[0], doc[1]);
+  t.notEqual(doc[1], doc[2]);
+  t.equal(doc[0].tags, doc[2].tags);
+  t.ok(Object.isFrozen(doc[0]) && Object.isFrozen(doc[0].tags), 'should be frozen');
+  t.notEqual(doc[3], doc[4]);
+  t.ok(!Object.isFrozen(doc), 'should not freeze values with dates');
+});
@@ -0,0 +1,64 @@
+var fs = require('fs');
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+test('compiled streams', function(t) {
+  t.plan(6);
+
+  var input = 'a: &x [1, 2.5, !!binary aGVsbG8=, str, ~, true]\nb: *x\n--- second';
+  var binding = require('../build/Release/binding');
+  var compiled = binding.compile(input, {});
+  var options = { tagHandlers: {} };
+
+  t.ok(Buffer.isBuffer(compiled), 'should compile to a Buffer');
+  t.ok(_.isEqual(binding.loadCompiled(compiled, options), YAML.parse(input)),
+      'should load the same documents');
+  t.equal(binding.loadCompiled(compiled.slice(1), options), null,
+      'should reject invalid input');
+
+  var corrupt = new Buffer(compiled.length);
+  compiled.copy(corrupt);
+  corrupt.fill(0xFF, 32, 40);
+  t.equal(binding.loadCompiled(corrupt, options), null, 'should reject bad records');
+
+  // Patch the type, count or target, and end of a record.
+  var patch = function(buffer, index, type, first, second) {
+    var offset = 32 + index * 24;
+    buffer[offset] = type;
+    buffer.writeUInt32LE(first, offset + 16);
+    buffer.writeUInt32LE(second, offset + 20);
+  };
+
+  var empty = binding.compile('--- [x]\n--- z', {});
+  patch(empty, 0, 0, 0, 1);
+  patch(empty, 1, 3, 0, 0);
+  patch(empty, 2, 0, 1, 4);
+  patch(empty, 3, 10, 0, 0);
+  t.equal(binding.loadCompiled(empty, options), null, 'should reject empty documents');
+
+  var dangling = new Buffer(compiled.length);
+  compiled.copy(dangling);
+  dangling.writeUInt32LE(10, 32 + 12 * 24 + 16);
+  dangling[32 + 10 * 24 + 1] = 1;
+  t.equal(binding.loadCompiled(dangling, options), null, 'should reject aliases to end records');
+});
+
+test('disk cache', function(t) {
+  t.plan(4);
+
+  var file = '/tmp/yaml.node-disk-cache-test.yml';
+  fs.writeFileSync(file, 'foo: [bar, 1]');
+
+  YAML.diskCache.enabled = true;
+  t.ok(_.isEqual(YAML.readFileSync(file), [{ foo: ['bar', 1] }]));
+  t.ok(fs.existsSync(file + 'c'), 'should write a compiled file');
+  t.ok(_.isEqual(YAML.readFileSync(file), [{ foo: ['bar', 1] }]), 'should load the compiled file');
+
+  fs.writeFileSync(file, 'foo: changed');
+  t.ok(_.isEqual(YAML.readFileSync(file), [{ foo: 'changed' }]), 'should see changes');
+
+  YAML.diskCache.enabled = false;
+  fs.unlinkSync(file);
+  fs.unlinkSync(file + 'c');
+});
@@ -5,6 +5,7 @@ testutil.simple('floats', [
     'canonical': 685230.15,
     'exponential': 685230.15,
     'fixed': 685230.15,
+    'long': 685230.15,
     'sexagesimal': 685230.15,
     'infinity': Infinity,
     'negative infinity': -Infinity,
@@ -0,0 +1,74 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+// Large enough to take many slices.
+var big = '';
+for (var i = 0; i < 5000; i++) {
+  big += 'item' + i + ': &a' + i + '\n';
+  big += '  - [1, 2.5, ' + (i ? '*a' + (i - 1) : '~') + ']\n';
+  big += '  - {name: n' + i + ', size: ' + i + '}\n';
+  big += '  - !upper text\n';
+}
+var handlers = { '!upper': function(value) { return value.toUpperCase(); } };
+
+test('incremental parse', function(t) {
+  var inputs = ['foo: [1, 2]', '- a\n- b', '--- 1\n--- !!binary aGVsbG8=', 'x: 2001-12-14'];
+  t.plan(inputs.length + 5);
+
+  inputs.forEach(function(input) {
+    YAML.parseIncremental(input, function(error, documents) {
+      t.ok(_.isEqual(documents, YAML.parse(input)), 'should match a sync parse');
+    });
+  });
+
+  var ticks = 0, done = false;
+  var tick = function() {
+    ticks++;
+    if (!done)
+      setTimeout(tick, 0);
+  };
+  setTimeout(tick, 0);
+  YAML.parseIncremental(big, handlers, { budgetMs: 0 }, function(error, documents) {
+    done = true;
+    t.ok(_.isEqual(documents, YAML.parse(big, handlers)), 'should match a sync parse in slices');
+    t.ok(ticks > 0, 'should yield to the event loop');
+  });
+
+  YAML.parseIncremental(big + 'foo: [', function(error, documents) {
+    t.ok(error instanceof Error, 'should pass parse errors');
+  });
+
+  YAML.parseIncremental('a: 1\na: 2', {}, { uniqueKeys: true }, function(error) {
+    t.ok(error instanceof Error, 'should check keys');
+  });
+
+  YAML.parseIncremental(big + 'last: !fail foo', {
+    '!fail': function() { throw new Error('handler failure'); }
+  }, { budgetMs: 0 }, function(error, documents) {
+    t.equal(error.message, 'handler failure', 'should pass handler errors');
+  });
+});
+
+test('incremental build options', function(t) {
+  var options = [{ typedArrays: true }, { columnar: true }, { maps: 2 }, { dedupe: true }];
+  t.plan(options.length);
+
+  options.forEach(function(option) {
+    var incremental = _.extend({ budgetMs: 0 }, option);
+    YAML.parseIncremental(big, handlers, incremental, function(error, documents) {
+      t.ok(_.isEqual(documents, YAML.parse(big, handlers, option)), 'should match a sync parse');
+    });
+  });
+});
+
+test('incremental parse with a promise', { skip: typeof Promise !== 'function' }, function(t) {
+  t.plan(2);
+
+  YAML.parseIncremental('foo: bar').then(function(documents) {
+    t.ok(_.isEqual(documents, [{ foo: 'bar' }]), 'should resolve with the documents');
+  });
+  YAML.parseIncremental('foo: [').then(null, function(error) {
+    t.ok(error instanceof Error, 'should reject with parse errors');
+  });
+});
@@ -5,6 +5,7 @@ testutil.simple('integers', [
     'canonical': 685230,
     'decimal': 685230,
     'octal': 685230,
+    'prefixed octal': 685230,
     'hexadecimal': 685230,
     'binary': 685230,
     'sexagesimal': 685230
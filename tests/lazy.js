@@ -0,0 +1,41 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+test('lazy documents', function(t) {
+  t.plan(13);
+
+  var input = [
+    'name: probe',
+    'ports: [80, 443]',
+    'base: &base { at: 2001-12-14, data: !!binary aGVsbG8= }',
+    'copy: *base',
+    '1: one',
+    '200: two hundred',
+    'name: second'
+  ].join('\n');
+  var doc = YAML.parseLazy(input)[0];
+
+  t.equal(doc.name, 'second', 'should use the last of duplicate keys');
+  t.equal(doc.ports.length, 2);
+  t.equal(doc.ports[1], 443);
+  t.equal(doc.ports[2], undefined);
+  t.equal(doc.ports, doc.ports, 'should build children once');
+  t.equal(doc.base.at.getTime(), Date.UTC(2001, 11, 14));
+  t.equal(doc.base.data.toString(), 'hello');
+  t.equal(doc.copy.data.toString(), 'hello');
+  t.equal(doc['1'], 'one');
+  t.equal(doc[200], 'two hundred', 'should read keys that are array indices');
+  t.ok('200' in doc);
+  t.ok(_.isEqual(Object.keys(doc), Object.keys(YAML.parse(input)[0])),
+      'should enumerate keys like a regular object');
+  t.throws(function() { doc.name = 'other'; }, 'should be read-only');
+});
+
+test('lazy scalar documents', function(t) {
+  t.plan(2);
+
+  var docs = YAML.parseLazy('--- foo\n--- [a, b]');
+  t.equal(docs[0], 'foo');
+  t.ok(_.isEqual(Array.prototype.slice.call(docs[1]), ['a', 'b']));
+});
@@ -0,0 +1,26 @@
+var test = require('tap').test;
+var YAML = require('../');
+
+var repeat = function(string, count) {
+  return new Array(count + 1).join(string);
+};
+
+test('long strings', function(t) {
+  t.plan(4);
+
+  var ascii = repeat('SELECT * FROM table;\n', 200);
+  var unicode = repeat('Grüße, 世界! 𝄞\n', 200);
+  var input = [
+    'ascii: |',
+    '  ' + ascii.replace(/\n(?!$)/g, '\n  '),
+    'unicode: &u |',
+    '  ' + unicode.replace(/\n(?!$)/g, '\n  '),
+    'alias: *u'
+  ].join('\n');
+  var doc = YAML.parse(input)[0];
+
+  t.equal(doc.ascii, ascii);
+  t.equal(doc.unicode, unicode);
+  t.equal(doc.alias, unicode);
+  t.equal(YAML.parse(YAML.stringify(doc))[0].unicode, unicode);
+});
@@ -1,6 +1,75 @@
+var _ = require('underscore');
+var test = require('tap').test;
 var testutil = require('../testutil');
+var YAML = require('../');
 
 testutil.simple('maps', [
   { one: 1, two: 2, three: 3 },
   { one: 1, two: 2, three: 3 }
 ]);
+
+test('maps with the same keys', function(t) {
+  t.plan(3);
+
+  var doc = YAML.parse([
+    '- { a: 1, b: { a: x, b: y } }',
+    '- { a: 2, b: { a: z, b: w } }',
+    '- { b: 3, a: 4 }',
+    '- { a: 5, a: 6 }'
+  ].join('\n'))[0];
+
+  var wanted = [
+    { a: 1, b: { a: 'x', b: 'y' } },
+    { a: 2, b: { a: 'z', b: 'w' } },
+    { b: 3, a: 4 },
+    { a: 6 }
+  ];
+  t.ok(_.isEqual(doc, wanted), 'should be equal', { found: doc, wanted: wanted });
+  t.ok(_.isEqual(_.keys(doc[2]), ['b', 'a']), 'should keep key order');
+  t.notEqual(doc[0], doc[1]);
+});
+
+test('map output', function(t) {
+  // Maps need a V8 with harmony collections.
+  if (typeof Map !== 'function') {
+    t.end();
+    return;
+  }
+  t.plan(6);
+
+  var input = 'small: { a: 1 }\nlarge: { 1: one, __proto__: two, ~: three }';
+  var doc = YAML.parse(input, {}, { maps: 3 })[0];
+  t.ok(!(doc.small instanceof Map), 'should be a plain object below the threshold');
+  t.ok(doc.large instanceof Map, 'should be a Map');
+  t.equal(doc.large.get(1), 'one');
+  t.equal(doc.large.get('__proto__'), 'two');
+  t.equal(doc.large.get(null), 'three');
+
+  doc = YAML.parse(input, {}, { maps: true })[0];
+  t.ok(doc instanceof Map && doc.get('small') instanceof Map, 'should all be Maps');
+});
+
+test('duplicate keys', function(t) {
+  t.plan(5);
+
+  var input = 'a: 1\nb: { x: 1, y: [{ x: 1 }], x: 2 }';
+  t.ok(_.isEqual(YAML.parse(input)[0].b.x, 2), 'should be allowed by default');
+
+  var error;
+  try {
+    YAML.parse(input, {}, { uniqueKeys: true });
+  }
+  catch (err) {
+    error = err;
+  }
+  t.equal(error.message, 'found duplicate key "x", first defined here, on line 1');
+  t.equal(error.context.column, 5);
+  t.equal(error.problem.column, 26);
+
+  t.throws(function() {
+    YAML.parse('{ 1: a, 1.0: b }', {}, { uniqueKeys: true });
+  }, {
+    name: 'Error',
+    message: 'found duplicate key "1.0", first defined here, on line 0'
+  });
+});
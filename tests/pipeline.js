@@ -0,0 +1,63 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+// Large enough to span many chunks and slices.
+var big = '';
+for (var i = 0; i < 5000; i++) {
+  big += 'item' + i + ': &a' + i + '\n';
+  big += '  - [1, 2.5, ' + (i ? '*a' + (i - 1) : '~') + ']\n';
+  big += '  - {name: n' + i + ', size: ' + i + '}\n';
+  big += '  - !upper text\n';
+}
+var handlers = { '!upper': function(value) { return value.toUpperCase(); } };
+
+test('pipelined parse', function(t) {
+  var inputs = ['foo: [1, 2]', '- a\n- b', '--- 1\n--- !!binary aGVsbG8=', 'x: 2001-12-14'];
+  t.plan(inputs.length + 5);
+
+  inputs.forEach(function(input) {
+    YAML.parseAsync(input, {}, { pipeline: true }, function(error, documents) {
+      t.ok(_.isEqual(documents, YAML.parse(input)), 'should match a sync parse');
+    });
+  });
+
+  var ticks = 0, done = false;
+  var tick = function() {
+    ticks++;
+    if (!done)
+      setTimeout(tick, 0);
+  };
+  setTimeout(tick, 0);
+  YAML.parseAsync(big, handlers, { pipeline: true, sliceMs: 0 }, function(error, documents) {
+    done = true;
+    t.ok(_.isEqual(documents, YAML.parse(big, handlers)), 'should match a sync parse in slices');
+    t.ok(ticks > 0, 'should yield to the event loop');
+  });
+
+  YAML.parseAsync('foo: [', {}, { pipeline: true }, function(error, documents) {
+    t.ok(error instanceof Error, 'should pass parse errors');
+  });
+
+  YAML.parseAsync('a: 1\na: 2', {}, { pipeline: true, uniqueKeys: true }, function(error) {
+    t.ok(error instanceof Error, 'should check keys');
+  });
+
+  YAML.parseAsync(big + 'last: !fail foo', {
+    '!fail': function() { throw new Error('handler failure'); }
+  }, { pipeline: true }, function(error, documents) {
+    t.equal(error.message, 'handler failure', 'should pass handler errors');
+  });
+});
+
+test('pipelined build options', function(t) {
+  var options = [{ typedArrays: true }, { columnar: true }, { maps: 2 }, { dedupe: true }];
+  t.plan(options.length);
+
+  options.forEach(function(option) {
+    var pipelined = _.extend({ pipeline: true, sliceMs: 0 }, option);
+    YAML.parseAsync(big, handlers, pipelined, function(error, documents) {
+      t.ok(_.isEqual(documents, YAML.parse(big, handlers, option)), 'should match a sync parse');
+    });
+  });
+});
@@ -0,0 +1,28 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+test('compiled tapes', function(t) {
+  t.plan(6);
+
+  var input = 'name: probe\nports: [80, 443]\nbase: &b { at: 2001-12-14 }\ncopy: *b';
+  var tape = YAML.compile(input);
+  t.ok(Buffer.isBuffer(tape));
+
+  var first = YAML.readTape(tape)[0], second = YAML.readTape(tape)[0];
+  t.equal(first.name, 'probe');
+  t.equal(second.ports[1], 443);
+  t.equal(first.copy.at.getTime(), Date.UTC(2001, 11, 14));
+
+  // Unaligned input is copied, rather than read in place.
+  var unaligned = new Buffer(tape.length + 1);
+  tape.copy(unaligned, 1);
+  t.ok(_.isEqual(Object.keys(YAML.readTape(unaligned.slice(1))[0]), Object.keys(first)));
+
+  t.throws(function() {
+    YAML.readTape(new Buffer('not a tape'));
+  }, {
+    name: 'Error',
+    message: 'Input is not a valid compiled YAML stream.'
+  });
+});
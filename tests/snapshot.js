@@ -0,0 +1,36 @@
+var fs = require('fs');
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+test('snapshots', function(t) {
+  t.plan(6);
+
+  var file = '/tmp/yaml.node-snapshot-test.ysnap';
+  YAML.writeSnapshotSync(file, [
+    'routes:',
+    '  - { path: /, target: &home home }',
+    '  - { path: /about, target: *home, data: !!binary aGVsbG8= }',
+    '--- second'
+  ].join('\n'));
+
+  var docs = YAML.openSnapshot(file);
+  t.equal(docs.length, 2);
+  t.equal(docs[0].routes.length, 2);
+  t.equal(docs[0].routes[1].target, 'home');
+  t.equal(docs[0].routes[1].data.toString(), 'hello');
+  t.equal(docs[1], 'second');
+
+  // The snapshot is still mapped, so write the invalid file elsewhere.
+  var invalid = '/tmp/yaml.node-snapshot-test-invalid.ysnap';
+  fs.writeFileSync(invalid, 'not a snapshot');
+  t.throws(function() {
+    YAML.openSnapshot(invalid);
+  }, {
+    name: 'Error',
+    message: 'File is not a valid snapshot for this build.'
+  });
+
+  fs.unlinkSync(invalid);
+  fs.unlinkSync(file);
+});
@@ -0,0 +1,34 @@
+var test = require('tap').test;
+var YAML = require('../');
+
+// Size of the synthetic document in megabytes. Can be lowered for quick runs.
+var size = Number(process.env.YAML_STREAMING_TEST_MB) || 200;
+
+test('streaming a large document', function(t) {
+  t.plan(2);
+
+  var line = '- "' + new Array(65).join('x') + '"\n';
+  var count = Math.ceil(size * 1024 * 1024 / line.length);
+  var input = new Array(count + 1).join(line);
+
+  // Sample heap usage while parsing. Event objects are discarded right away, so once the parser
+  // is warmed up, heap usage should stay flat.
+  var events = 0, warmup = 100000, baseline = 0, peak = 0;
+  YAML.stream.parse(input, function(ev) {
+    events++;
+    if (events % 10000 === 0) {
+      var used = process.memoryUsage().heapUsed;
+      if (events === warmup)
+        baseline = used;
+      else if (events > warmup && used > peak)
+        peak = used;
+    }
+  });
+
+  // Stream, document and sequence start and end, plus a scalar per line.
+  t.equal(events, count + 6);
+  t.ok(peak - baseline < 64 * 1024 * 1024, 'heap usage should stay flat', {
+    baseline: baseline,
+    peak: peak
+  });
+});
@@ -0,0 +1,50 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var testutil = require('../testutil');
+var YAML = require('../');
+
+// Not a `testutil.simple` test, because strings like '123' don't survive a round trip.
+test('standard tags', function(t) {
+  t.plan(1);
+
+  var expected = [
+    {
+      'string': '123',
+      'quoted': '456',
+      'integer': 31,
+      'float': 1.5,
+      'integer float': 3,
+      'boolean': true,
+      'null': null,
+      'timestamp': new Date('2002-12-14T00:00:00.00Z')
+    }
+  ];
+
+  var result = YAML.readFileSync(testutil.inputPath('tags'));
+  t.ok(_.isEqual(result, expected), 'should be equal', {
+    found: result,
+    wanted: expected
+  });
+});
+
+test('mismatched standard tags', function(t) {
+  t.plan(1);
+
+  t.throws(function() {
+    YAML.parse('!!int foo');
+  }, {
+    name: 'Error',
+    message: 'found a scalar that does not match its tag, on line 0'
+  });
+});
+
+test('tag handlers for standard tags', function(t) {
+  t.plan(1);
+
+  var result = YAML.parse('!!int 5', {
+    'tag:yaml.org,2002:int': function(value) {
+      return value + 1;
+    }
+  });
+  t.equal(result[0], 6);
+});
@@ -0,0 +1,47 @@
+var _ = require('underscore');
+var test = require('tap').test;
+var YAML = require('../');
+
+var toArray = function(array) {
+  return Array.prototype.slice.call(array);
+};
+
+test('typed arrays', function(t) {
+  t.plan(9);
+
+  var doc = YAML.parse([
+    'ints: [1, -2, 0x10, 2147483647]',
+    'floats: [0.5, 1e3, .inf]',
+    'large: [1, 4294967296]',
+    'mixed: [1, two, 3]',
+    'nested: [[1, 2], [3]]',
+    'empty: []'
+  ].join('\n'), {}, { typedArrays: true })[0];
+
+  t.ok(doc.ints instanceof Int32Array, 'should be an Int32Array');
+  t.ok(_.isEqual(toArray(doc.ints), [1, -2, 16, 2147483647]), 'should be equal');
+  t.ok(doc.floats instanceof Float64Array, 'should be a Float64Array');
+  t.ok(_.isEqual(toArray(doc.floats), [0.5, 1000, Infinity]), 'should be equal');
+  t.ok(doc.large instanceof Float64Array, 'should be a Float64Array');
+  t.ok(_.isEqual(doc.mixed, [1, 'two', 3]), 'should be equal');
+  t.ok(Array.isArray(doc.nested) && doc.nested[0] instanceof Int32Array,
+      'should contain typed arrays');
+  t.ok(_.isEqual(doc.empty, []), 'should be equal');
+
+  var plain = YAML.parse('[1, 2, 3]')[0];
+  t.ok(Array.isArray(plain), 'should be an array by default');
+});
+
+test('typed arrays with anchors and tags', function(t) {
+  t.plan(3);
+
+  var doc = YAML.parse('a: &a [1.5, 2.5]\nb: *a\nc: [!half 1, 2]', {
+    '!half': function(value) {
+      return value / 2;
+    }
+  }, { typedArrays: true })[0];
+
+  t.ok(doc.a instanceof Float64Array, 'should be a Float64Array');
+  t.equal(doc.b, doc.a);
+  t.ok(_.isEqual(doc.c, [0.5, 2]), 'should be equal');
+});